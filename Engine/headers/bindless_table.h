@@ -0,0 +1,77 @@
+#pragma once
+#ifndef BINDLESS_TABLE_H
+#define BINDLESS_TABLE_H
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One descriptor set that holds every texture and storage buffer the shaders can reach, in two large partially bound arrays. Resources are added once and
+// keep a stable index that shaders are handed through push constants, so drawing needs no per-draw descriptor set binds and draws with different
+// resources can be merged. The set is update-after-bind: slots can be written while it is bound, as long as no submitted work reads those slots
+class BindlessTable {
+
+public:
+
+    static constexpr uint32_t textureBinding = 0; // combined image samplers, e.g. sampler2D textures[]
+    static constexpr uint32_t bufferBinding = 1; // storage buffers, e.g. buffer Buffers { ... } buffers[]
+
+private:
+
+    VkDevice logicalDevice;
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+
+    uint32_t textureCapacity;
+    uint32_t bufferCapacity;
+
+    // slots below the high water mark have been handed out, released ones are handed out again first
+    uint32_t textureHighWater = 0;
+    uint32_t bufferHighWater = 0;
+    std::vector<uint32_t> freeTextures;
+    std::vector<uint32_t> freeBuffers;
+
+    static uint32_t allocateSlot(uint32_t& highWater, std::vector<uint32_t>& freeSlots, uint32_t capacity);
+
+public:
+
+    // Whether the device has the descriptor indexing features the table needs. Only valid for Vulkan 1.2 devices
+    static bool isSupported(VkPhysicalDevice physicalDevice);
+
+    // Turn on those features in the Vulkan 1.2 features chained into the device create info
+    static void enableFeatures(VkPhysicalDeviceVulkan12Features& features);
+
+    // The capacities are clamped to the device's update-after-bind limits
+    BindlessTable(VkDevice& logicalDevice, VkPhysicalDevice physicalDevice, uint32_t maxTextures, uint32_t maxBuffers);
+
+    // Returns the index shaders read the texture at
+    uint32_t addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+
+    // Returns the index shaders read the buffer at
+    uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // Hand the slot out again with a later add. The slot's old descriptor stays in place until then, so only release it once no frame in flight
+    // can still read it, e.g. from the deletion queue
+    void releaseTexture(uint32_t index);
+    void releaseBuffer(uint32_t index);
+
+    VkDescriptorSetLayout getSetLayout() const;
+    VkDescriptorSet getSet() const;
+
+    // The binding types in binding order, for PipelineLayoutCache::reserveSet
+    static std::vector<VkDescriptorType> bindingTypes();
+
+    // Slots in use
+    uint32_t getTextureCount() const;
+    uint32_t getBufferCount() const;
+
+    uint32_t getTextureCapacity() const;
+    uint32_t getBufferCapacity() const;
+
+    void destroy();
+
+};
+
+#endif // BINDLESS_TABLE_H
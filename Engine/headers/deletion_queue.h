@@ -0,0 +1,37 @@
+#pragma once
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Defers the destruction of GPU resources until every frame that could still be using them has finished on the GPU,
+// so resources can be replaced mid-run (swap chain recreation, pipeline rebuilds) without a vkDeviceWaitIdle stall
+class DeletionQueue {
+
+private:
+
+    struct PendingDeletion {
+        uint64_t retireFrame; // number of frames that had been submitted when the resource was retired
+        std::function<void()> destroy;
+    };
+
+    std::deque<PendingDeletion> pending; // ordered by retireFrame since frames are only ever retired in submission order
+
+public:
+
+    // Queue a resource for destruction. retireFrame is the number of frames submitted so far, so every frame that could reference the resource has a lower frame number
+    void retire(uint64_t retireFrame, std::function<void()> destroy);
+
+    // Destroy every resource whose frames have all completed. completedFrames is the number of frames the GPU is known to have finished
+    void collect(uint64_t completedFrames);
+
+    // Destroy everything that is still queued. Only safe once the device is idle
+    void flush();
+
+    size_t size() const;
+
+};
+
+#endif // DELETION_QUEUE_H
@@ -0,0 +1,92 @@
+#pragma once
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One resource a descriptor set points a binding at
+struct DescriptorResource {
+    uint32_t binding;
+    VkDescriptorType type;
+    VkDescriptorBufferInfo buffer{}; // buffer types
+    VkDescriptorImageInfo image{}; // image and sampler types
+
+    static DescriptorResource storageBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    static DescriptorResource dynamicUniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize range); // range is the slice size, the offset comes at bind time
+    static DescriptorResource combinedImageSampler(uint32_t binding, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+    static DescriptorResource storageImage(uint32_t binding, VkImageView imageView, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_GENERAL);
+
+    // Field by field, the structs can contain padding
+    bool operator==(const DescriptorResource& other) const;
+};
+
+// Hands out descriptor sets from pools that are only ever reset in bulk, never freed set by set, which is a known CPU hotspot.
+// Transient sets come from pools owned by a frame in flight: they are valid until the frame's slot comes round again, when beginFrame resets all of its
+// pools with vkResetDescriptorPool. Long-lived sets are cached by layout and resources, so asking for the same set twice returns the same handle, and
+// live until the allocator is destroyed. Both kinds grow by taking another pool when one runs out, each new pool twice the size of the last
+class DescriptorAllocator {
+
+public:
+
+    struct Stats {
+        uint32_t poolCount = 0; // created so far, transient and long-lived
+        uint64_t transientSets = 0;
+        uint64_t poolResets = 0;
+        uint32_t cachedSets = 0;
+        uint64_t cacheHits = 0;
+    };
+
+private:
+
+    // pools one owner allocates from, the last one is the one being filled
+    struct PoolChain {
+        std::vector<VkDescriptorPool> pools;
+    };
+
+    VkDevice logicalDevice;
+
+    std::vector<PoolChain> frames; // one per frame in flight
+    PoolChain persistent;
+    std::vector<VkDescriptorPool> freePools; // reset and ready to be handed to another chain
+
+    uint32_t nextPoolSets = 64; // sets per pool, doubled with every pool created up to maxPoolSets
+    static constexpr uint32_t maxPoolSets = 4096;
+
+    struct CachedSet {
+        VkDescriptorSetLayout setLayout;
+        std::vector<DescriptorResource> resources;
+        VkDescriptorSet set;
+    };
+
+    std::unordered_map<uint64_t, std::vector<CachedSet>> cachedSets; // by hash of layout and resources, more than one only if different contents collided
+
+    Stats stats;
+
+    VkDescriptorPool acquirePool();
+    VkDescriptorSet allocate(PoolChain& chain, VkDescriptorSetLayout setLayout);
+    void write(VkDescriptorSet set, const std::vector<DescriptorResource>& resources);
+
+public:
+
+    DescriptorAllocator(VkDevice& logicalDevice, uint32_t framesInFlight);
+
+    // Reset the frame's transient pools. Only call once the fence of the frame that last used the slot has signaled
+    void beginFrame(uint32_t frame);
+
+    // A set for the current frame only, written with the resources
+    VkDescriptorSet allocateTransient(uint32_t frame, VkDescriptorSetLayout setLayout, const std::vector<DescriptorResource>& resources);
+
+    // The set with this layout pointing at these resources, allocated and written the first time it is asked for. Sets stay in the cache after their
+    // resources are destroyed, so don't ask for sets of recreated resources through here; those are what transient sets are for
+    VkDescriptorSet getPersistent(VkDescriptorSetLayout setLayout, const std::vector<DescriptorResource>& resources);
+
+    const Stats& getStats() const;
+
+    void destroy();
+
+};
+
+#endif // DESCRIPTOR_ALLOCATOR_H
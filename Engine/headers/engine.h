@@ -14,7 +14,44 @@
 #include <optional>
 #include <algorithm>
 #include <limits>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <functional>
+#include <fstream>
+#include <memory>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
+#include "hash.h"
+#include "mapped_file.h"
+#include "shader_artifact_cache.h"
+#include "shader_optimizer.h"
+#include "shader_compiler.h"
+#include "shader_reflection.h"
 #include "shader_manager.h"
+#include "shader_watcher.h"
+#include "deletion_queue.h"
+#include "frame_pacer.h"
+#include "latency_monitor.h"
+#include "gpu_allocator.h"
+#include "queue_topology.h"
+#include "upload_manager.h"
+#include "vertex_format.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include "mesh_cooker.h"
+#include "meshlet.h"
+#include "pipeline_cache.h"
+#include "thread_pool.h"
+#include "pipeline_desc.h"
+#include "pipeline_compiler.h"
+#include "pipeline_registry.h"
+#include "pipeline_layout_cache.h"
+#include "bindless_table.h"
+#include "descriptor_allocator.h"
+#include "uniform_ring.h"
+#include "shader_permutations.h"
 
 #endif // ENGINE_H
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+
+// Caps the frame rate at a target and measures the CPU time spent handing each frame to the queues, from the submit call until the present call returns.
+// That is the cost of the submit and present calls on the CPU. The latency from submission to the GPU and the display is measured by LatencyMonitor.
+// Lets the engine trade latency for power (a lower target lets the CPU and GPU idle between frames) without changing the present mode
+class FramePacer {
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration targetFrameTime = Clock::duration::zero(); // zero means the frame rate is not limited
+    Clock::time_point nextFrameDeadline;
+
+    Clock::time_point submitTime;
+    Clock::time_point lastFrameStart;
+    bool hasLastFrame = false;
+
+    double lastQueueCallMs = 0.0;
+    double averageQueueCallMs = 0.0; // exponential moving average so single spikes don't dominate, seeded with the first sample
+    double averageFrameIntervalMs = 0.0;
+    bool hasQueueCallSample = false;
+    bool hasFrameIntervalSample = false;
+
+    static constexpr double smoothing = 0.1; // weight of the newest sample in the moving averages
+
+public:
+
+    // Limit the frame rate to framesPerSecond, 0 removes the limit
+    void setTargetFrameRate(double framesPerSecond);
+
+    double getTargetFrameRate() const;
+
+    // Block until the next frame is due. Sleeps for most of the wait and spins for the last stretch, since sleep granularity is too coarse for accurate pacing
+    void waitForNextFrame();
+
+    // Call right before the frame's command buffers are submitted
+    void markSubmit();
+
+    // Call right after the frame's present call returns, or after its submit in headless mode
+    void markPresent();
+
+    // CPU time from markSubmit to markPresent
+    double getLastQueueCallMilliseconds() const;
+
+    double getAverageQueueCallMilliseconds() const;
+
+    double getAverageFrameIntervalMilliseconds() const;
+
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef GPU_ALLOCATOR_H
+#define GPU_ALLOCATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// What the memory is used for, which decides the memory type it comes from
+enum class MemoryUsage {
+    GpuOnly, // device local, never touched by the CPU -- render targets, vertex and index buffers filled through a staging copy
+    Upload, // host visible, written by the CPU and read by the GPU -- staging buffers, per-frame uniforms
+    Readback // host visible and preferably cached, written by the GPU and read by the CPU
+};
+
+// A range of device memory handed out by the GpuAllocator. Resources are bound at memory + offset
+struct GpuAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; // persistently mapped pointer to the start of the allocation, null for GpuOnly memory
+    bool coherent = true; // false if writes have to be flushed and reads invalidated
+    uint32_t memoryType = 0;
+
+    // where the range came from, used to give it back
+    uint32_t blockIndex = UINT32_MAX;
+    uint32_t order = 0;
+};
+
+// Sub-allocates resources out of large VkDeviceMemory blocks instead of calling vkAllocateMemory per resource, which is slow and runs into
+// maxMemoryAllocationCount. Each block is managed as a buddy allocator: ranges are power of two sized and naturally aligned, and freed ranges merge
+// with their buddy, which keeps fragmentation bounded and makes allocating and freeing O(log n). Buffers and optimally tiled images are kept in
+// separate blocks so bufferImageGranularity never has to be considered. Allocations larger than half a block get their own dedicated memory
+class GpuAllocator {
+
+public:
+
+    struct HeapStats {
+        VkDeviceSize heapSize = 0;
+        bool deviceLocal = false;
+        uint32_t blockCount = 0; // device memory allocations, including dedicated ones
+        uint32_t allocationCount = 0; // ranges handed out
+        VkDeviceSize reservedBytes = 0; // allocated from the device
+        VkDeviceSize usedBytes = 0; // handed out, rounded up to the buddy size
+        VkDeviceSize requestedBytes = 0; // what was actually asked for
+        VkDeviceSize largestFreeRange = 0;
+        double fragmentation = 0.0; // 1 - largest free range / free bytes, 0 when all free memory is in one piece
+    };
+
+private:
+
+    static constexpr VkDeviceSize minAllocationSize = 256;
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        bool linear = true; // buffers and linear images, or optimally tiled images
+        bool dedicated = false;
+        void* mapped = nullptr;
+        std::vector<std::set<VkDeviceSize>> freeLists; // free range offsets per order, a range of order k is minAllocationSize << k bytes
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize requestedBytes = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    VkDevice logicalDevice;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize nonCoherentAtomSize;
+    VkDeviceSize blockSize;
+
+    std::vector<Block> blocks; // freed blocks are left empty and reused, so block indices stay valid
+    std::mutex mutex;
+
+    uint32_t findMemoryType(uint32_t typeFilter, MemoryUsage usage) const;
+    uint32_t createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated);
+    bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& order);
+    void freeBlock(Block& block);
+    VkMappedMemoryRange alignedRange(const GpuAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+public:
+
+    // blockSize is rounded up to a power of two
+    GpuAllocator(VkDevice& logicalDevice, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+
+    // Allocate memory meeting requirements. linear is false for optimally tiled images. Throws if the device is out of memory
+    GpuAllocation allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear = true);
+
+    // Allocate and bind memory for a buffer
+    GpuAllocation allocateBuffer(VkBuffer buffer, MemoryUsage usage);
+
+    // Allocate and bind memory for an image
+    GpuAllocation allocateImage(VkImage image, MemoryUsage usage, bool optimalTiling = true);
+
+    void free(GpuAllocation& allocation);
+
+    // Make CPU writes visible to the GPU. Only needed for non-coherent memory, a no-op otherwise
+    void flush(const GpuAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    // Make GPU writes visible to the CPU. Only needed for non-coherent memory, a no-op otherwise
+    void invalidate(const GpuAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    // Usage and fragmentation of every memory heap
+    std::vector<HeapStats> getHeapStats();
+
+    // Free every block. Allocations that weren't freed become invalid
+    void destroy();
+
+};
+
+#endif // GPU_ALLOCATOR_H
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// FNV-1a, used for cache keys. Not cryptographic, but fast, stable across runs and platforms (so it can key on-disk caches) and good enough to tell assets apart
+namespace Hash {
+
+    constexpr uint64_t offsetBasis = 14695981039346656037ull;
+    constexpr uint64_t prime = 1099511628211ull;
+
+    inline uint64_t bytes(const void* data, size_t size, uint64_t hash = offsetBasis) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= prime;
+        }
+        return hash;
+    }
+
+    inline uint64_t string(const std::string& value, uint64_t hash = offsetBasis) {
+        return bytes(value.data(), value.size(), hash);
+    }
+
+    // 128-bit FNV-1a, for content that is identified by its hash alone without keeping the content around to compare
+    struct Wide {
+        uint64_t low;
+        uint64_t high;
+
+        bool operator==(const Wide& other) const {
+            return low == other.low && high == other.high;
+        }
+    };
+
+    inline Wide wideBytes(const void* data, size_t size) {
+        constexpr uint64_t primeLow = 0x13b; // the prime is 2^88 + 0x13b
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        Wide hash{ 0x62b821756295c58dull, 0x6c62272e07bb0142ull };
+        for (size_t i = 0; i < size; i++) {
+            hash.low ^= bytes[i];
+
+            // multiply in 32-bit halves, there is no portable 128-bit integer
+            uint64_t productLow = (hash.low & 0xffffffffull) * primeLow;
+            uint64_t productHigh = (hash.low >> 32) * primeLow + (productLow >> 32);
+            uint64_t low = (productHigh << 32) | (productLow & 0xffffffffull);
+            hash.high = hash.high * primeLow + (productHigh >> 32) + (hash.low << 24);
+            hash.low = low;
+        }
+        return hash;
+    }
+
+    // Fold a value into a running hash. Only for trivially copyable values without padding
+    template<typename T>
+    inline uint64_t combine(uint64_t hash, const T& value) {
+        return bytes(&value, sizeof(T), hash);
+    }
+
+}
+
+#endif // HASH_H
@@ -0,0 +1,100 @@
+#pragma once
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vulkan/vulkan.h>
+
+// Measures each frame's latency from its submission to the GPU finishing it, and where the device supports VK_GOOGLE_display_timing, to the image
+// reaching the display. A thread waits on every submitted frame's fence, so the completion time is taken when the fence signals instead of when the
+// render loop next gets round to checking it, which would add up to a whole frame of error
+class LatencyMonitor {
+
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+private:
+
+    struct Submission {
+        VkFence fence;
+        Clock::time_point submitTime;
+    };
+
+    // an exponential moving average, seeded with the first sample so the early values aren't pulled toward zero
+    struct Average {
+        double last = 0.0;
+        double average = 0.0;
+        uint64_t samples = 0;
+
+        void add(double value);
+    };
+
+    VkDevice logicalDevice;
+
+    std::thread waitThread;
+    mutable std::mutex mutex;
+    std::condition_variable submitted; // a submission was queued, or the monitor is stopping
+    std::condition_variable finished; // the thread is done with another fence
+    std::deque<Submission> submissions;
+    uint64_t ticketsIssued = 0;
+    uint64_t ticketsFinished = 0;
+    bool stopping = false;
+
+    Average gpuLatency;
+
+    PFN_vkGetPastPresentationTimingGOOGLE getPastPresentationTiming = nullptr; // set when display timing is enabled
+    std::map<uint32_t, Clock::time_point> pendingPresents; // present id -> submit time, until the display timing reports it
+    Average displayLatency;
+
+    static constexpr double smoothing = 0.1; // weight of the newest sample in the moving averages
+    static constexpr size_t maxPendingPresents = 64; // presents the driver never reports on (a recreated swap chain) are dropped past this
+
+    void waitLoop();
+
+public:
+
+    LatencyMonitor(VkDevice& logicalDevice);
+
+    // Joins the thread once every tracked fence has signaled. The fences have to be alive until then, or waitIdle has to have returned
+    ~LatencyMonitor();
+
+    LatencyMonitor(const LatencyMonitor&) = delete;
+    LatencyMonitor& operator=(const LatencyMonitor&) = delete;
+
+    // Measure the submission that signals fence. The returned ticket goes to release() before the fence is reset or destroyed
+    uint64_t track(VkFence fence, Clock::time_point submitTime);
+
+    // Block until the thread has stopped waiting on the ticket's fence. Returns right away once the fence has signaled. 0 is never issued
+    void release(uint64_t ticket);
+
+    // Block until the thread has stopped waiting on every tracked fence
+    void waitIdle();
+
+    // Report presentation times through VK_GOOGLE_display_timing. The extension's times have to be in the steady clock's domain (CLOCK_MONOTONIC)
+    void enableDisplayTiming();
+
+    bool hasDisplayTiming() const;
+
+    // Remember a present that was tagged with presentId in VkPresentTimesInfoGOOGLE
+    void trackPresent(uint32_t presentId, Clock::time_point submitTime);
+
+    // Pick up the presentation times the driver has reported for the swap chain
+    void collectPresentTimes(VkSwapchainKHR swapChain);
+
+    // Presents of a replaced swap chain are never reported
+    void forgetPresents();
+
+    double getAverageGpuLatencyMilliseconds() const;
+
+    double getAverageDisplayLatencyMilliseconds() const;
+
+};
+
+#endif // LATENCY_MONITOR_H
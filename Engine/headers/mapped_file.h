@@ -0,0 +1,39 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. The data is paged in by the OS on first touch instead of being copied into a buffer,
+// and the mapping starts on a page boundary so it is suitably aligned for any word type
+class MappedFile {
+
+private:
+
+    const void* data = nullptr;
+    size_t size = 0;
+
+#ifdef PLATFORM_WINDOWS
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    void close();
+
+public:
+
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void* getData() const;
+
+    size_t getSize() const;
+
+};
+
+#endif // MAPPED_FILE_H
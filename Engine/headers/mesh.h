@@ -0,0 +1,59 @@
+#pragma once
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "vertex_format.h"
+
+// A vertex at full precision, the way meshes are generated and loaded before they are encoded for the GPU
+struct MeshVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec4 tangent; // w is the bitangent sign
+    glm::vec2 texCoord;
+    glm::vec4 color;
+};
+
+// An indexed triangle list. Right-handed with y up, and front faces wind counter-clockwise
+struct MeshData {
+    // The winding above as the rasterizer sees it. The projections flip y for Vulkan's downward pointing framebuffer y, which keeps counter-clockwise counter-clockwise
+    static constexpr VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // Unit sphere with rings + 1 rows of segments + 1 vertices, so the texture coordinates can wrap around the seam. Colored by its normals
+    static MeshData makeSphere(uint32_t rings, uint32_t segments);
+
+    // Wavefront OBJ: positions, texture coordinates, normals and polygon faces, which are fanned into triangles. Vertices are shared between faces that use
+    // the same position, texture coordinate and normal. Missing normals are generated from the faces, tangents are left pointing along x. Throws if the file can't be read
+    static MeshData loadObj(const std::string& filename);
+
+    // Radius of the sphere around the bounding box center that holds every vertex
+    void getBounds(glm::vec3& center, float& radius) const;
+};
+
+// Mesh data in a VertexFormat, ready to be copied into a vertex and an index buffer. Quantized attributes are stored relative to the mesh's bounds,
+// and the vertex shader undoes it with the decode scale and offset: position = stored * positionScale + positionOffset, likewise for texture coordinates
+struct EncodedMesh {
+    VertexFormat format;
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec2 texCoordScale = glm::vec2(1.0f);
+    glm::vec2 texCoordOffset = glm::vec2(0.0f);
+
+    static EncodedMesh encode(const MeshData& mesh, const VertexFormat& format);
+};
+
+#endif // MESH_H
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef MESH_COOKER_H
+#define MESH_COOKER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "mesh.h"
+#include "mesh_optimizer.h"
+
+// The asset cook step for meshes: loads the source, runs the mesh optimizer over it and stores the result on disk as <key>.mesh, so the engine only
+// pays for the optimization the first time it sees a mesh. The key covers the source contents and the optimizer version
+class MeshCooker {
+
+public:
+
+    struct Result {
+        MeshData mesh;
+        VertexCacheStats before; // as the source was ordered
+        VertexCacheStats after;
+        bool cached = false; // loaded from an earlier cook
+    };
+
+private:
+
+    std::string cacheDirectory;
+
+    std::string cookedPath(uint64_t key) const;
+
+    bool load(uint64_t key, Result& result) const;
+
+    // Failing to write is not an error, the mesh just gets cooked again next time
+    void store(uint64_t key, const Result& result) const;
+
+public:
+
+    MeshCooker(const std::string& cacheDirectory);
+
+    // Cook a mesh file. Only OBJ is supported for now
+    Result cookFile(const std::string& filename) const;
+
+    // Cook generated geometry. sourceKey has to cover everything the generator's output depends on
+    Result cook(uint64_t sourceKey, const std::function<MeshData()>& generate) const;
+
+};
+
+#endif // MESH_COOKER_H
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// How well an index buffer reuses the post-transform vertex cache, simulated as a FIFO cache
+struct VertexCacheStats {
+    float acmr = 0.0f; // average cache miss ratio -- vertex shader invocations per triangle, 0.5 is the ideal for large regular meshes, 3 the worst case
+    float atvr = 0.0f; // average transformed vertex ratio -- vertex shader invocations per vertex, 1 is the ideal
+};
+
+// Reorders meshes so the GPU does less work drawing them: fewer vertex shader invocations, fewer shaded pixels that end up hidden and fewer cache
+// lines fetched per vertex. Only the order of triangles and vertices changes, so the result renders the same and the savings cost nothing at runtime
+namespace MeshOptimizer {
+
+    // Vertices the simulated FIFO cache holds. Hardware caches differ in size and policy, 16 is a conservative stand-in
+    constexpr uint32_t simulatedCacheSize = 16;
+
+    // Bumped whenever a pass changes, so cooked meshes are optimized again
+    constexpr uint32_t version = 1;
+
+    VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = simulatedCacheSize);
+
+    // Reorder triangles so vertices are reused while they are still in the cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+    void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+    // Reorder clusters of a vertex cache optimized index buffer so the triangles facing outwards are drawn first and occlude the rest (Sander et al.,
+    // "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"). The clusters are cut where the cache is cold anyway, and only split further
+    // as long as the ACMR stays within threshold of what the vertex cache optimization achieved
+    void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, float threshold = 1.05f);
+
+    // Reorder the vertices into the order the index buffer first uses them, so neighbouring invocations fetch neighbouring memory. Unused vertices are dropped
+    void optimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+
+    // Run every pass in order and return the cache statistics from before and after
+    void optimize(MeshData& mesh, VertexCacheStats& before, VertexCacheStats& after);
+
+}
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// A small cluster of a mesh's triangles with its own vertex list, sized so one mesh shader workgroup can output it. The layout matches the shaders' std430 structs
+struct Meshlet {
+    static constexpr uint32_t maxVertices = 64;
+    static constexpr uint32_t maxTriangles = 124; // 124 * 3 local indices plus the counts stay within NVIDIA's recommended output size
+
+    uint32_t vertexOffset; // first entry in MeshletData::vertices
+    uint32_t triangleOffset; // first entry in MeshletData::triangles
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// What cluster culling tests a meshlet with. A meshlet is outside the view if its bounding sphere is, and entirely back-facing if the camera lies inside the
+// cone opposite its normals: dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius
+struct MeshletBounds {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis; // average direction the triangles face
+    float coneCutoff; // sine of the cone's half angle, 1 when the normals spread too far to ever cull the meshlet
+};
+
+// A mesh split into meshlets. Vertices are indices into the mesh's vertex buffer, triangles are three 8-bit meshlet-local indices packed into a uint32
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> triangles;
+
+    // Fill meshlets greedily in index buffer order, so a vertex cache optimized mesh gives compact meshlets
+    static MeshletData build(const MeshData& mesh);
+};
+
+#endif // MESHLET_H
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Persistent VkPipelineCache. Loaded from disk at startup so pipelines compiled on a previous run don't have to be compiled again, and written back at shutdown.
+// The file is only used if it was written by the same device and driver, a cache from another GPU or driver version is discarded
+class PipelineCache {
+
+private:
+
+    // Written in front of the driver's cache data. The driver validates its own header too, but not every driver checks the driver version, and none check for truncated files
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash; // FNV-1a hash of the driver data, catches truncated or corrupted files
+    };
+
+    static constexpr uint32_t fileMagic = 0x48504331; // "HPC1"
+    static constexpr uint32_t fileVersion = 1;
+
+    VkDevice logicalDevice;
+    VkPhysicalDeviceProperties deviceProperties;
+    std::string cachePath;
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE; // the main cache, worker caches are merged into it
+
+    std::mutex workerMutex;
+    std::vector<VkPipelineCache> workerCaches; // one per worker thread, so threads don't contend on the driver's internal cache lock
+
+    std::vector<char> loadValidatedData();
+
+public:
+
+    PipelineCache(VkDevice& logicalDevice, VkPhysicalDevice physicalDevice, const std::string& cachePath);
+
+    VkPipelineCache getHandle() const;
+
+    // Create a cache for a worker thread to compile pipelines with. It is merged into the main cache by mergeWorkerCaches and destroyed with the main cache
+    VkPipelineCache createWorkerCache();
+
+    // Merge everything the worker caches have collected into the main cache
+    void mergeWorkerCaches();
+
+    // Write the cache to disk. The data goes to a temporary file first which then replaces the old file, so a crash mid-write can't leave a corrupt cache behind
+    void save();
+
+    void destroy();
+
+};
+
+#endif // PIPELINE_CACHE_H
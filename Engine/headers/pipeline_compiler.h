@@ -0,0 +1,95 @@
+#pragma once
+#ifndef PIPELINE_COMPILER_H
+#define PIPELINE_COMPILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "pipeline_cache.h"
+#include "pipeline_desc.h"
+#include "thread_pool.h"
+
+using PipelineHandle = uint32_t;
+
+// Compiles graphics pipelines on a thread pool so pipeline creation never blocks the frame loop. Each submitted description gets a handle right away;
+// until its pipeline has finished compiling, getPipeline returns a cheap fallback pipeline instead so drawing can continue. Without a registered
+// fallback, every submit also compiles its own description with driver optimizations disabled on the pool, so each variant falls back to itself.
+// Handles are created and looked up from the main thread, the compiles themselves run on the pool's workers
+class PipelineCompiler {
+
+private:
+
+    struct PipelineSlot {
+        std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE }; // published by the worker once the compile finished
+        std::atomic<VkPipeline> fallback{ VK_NULL_HANDLE }; // used while the real pipeline is compiling
+        std::shared_future<VkPipeline> compiled;
+        std::shared_future<VkPipeline> generatedFallback; // valid when the compiler builds the slot's fallback itself, which it then owns
+
+        // rebuilds replace the pipeline of an existing handle, but only when the main thread publishes them so it knows which pipeline to retire
+        std::shared_future<VkPipeline> rebuilt;
+        bool rebuilding = false;
+        std::unique_ptr<GraphicsPipelineDesc> queuedRebuild; // a rebuild requested while another compile for the slot was still running
+    };
+
+    VkDevice logicalDevice;
+    PipelineCache& pipelineCache;
+    ThreadPool& threadPool;
+
+    std::deque<PipelineSlot> slots; // a deque never moves its elements, so workers can keep a reference to their slot while new slots are added
+    std::vector<PipelineHandle> rebuildingHandles;
+    std::vector<VkPipelineCache> workerCaches; // one per pool worker
+
+    VkPipeline defaultFallback = VK_NULL_HANDLE;
+    std::vector<VkPipeline> fallbacks; // registered fallbacks, owned by the compiler
+
+    VkPipeline compile(const GraphicsPipelineDesc& desc);
+
+    void startRebuild(PipelineSlot& slot, const GraphicsPipelineDesc& desc);
+
+public:
+
+    PipelineCompiler(VkDevice& logicalDevice, PipelineCache& pipelineCache, ThreadPool& threadPool);
+
+    // Hand a pipeline to the compiler to use in place of pipelines that are still compiling. The compiler takes ownership of it.
+    // A fallback should be cheap to build, e.g. the same state compiled with VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT or a flat shaded pipeline.
+    // The first registered fallback becomes the default for submits that don't name their own
+    VkPipeline registerFallback(VkPipeline fallback);
+
+    // Queue a pipeline for compilation and return its handle. fallback is drawn with until the compile is done, VK_NULL_HANDLE uses the default fallback.
+    // With no default either, desc is queued a second time with VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT, ahead of the optimized compile
+    PipelineHandle submit(const GraphicsPipelineDesc& desc, VkPipeline fallback = VK_NULL_HANDLE);
+
+    // Compile desc in the background as the new pipeline for an existing handle. The handle keeps returning its current pipeline until
+    // publishRebuilds swaps the new one in. If the rebuild fails, the handle keeps its current pipeline
+    void rebuild(PipelineHandle handle, const GraphicsPipelineDesc& desc);
+
+    // Swap finished rebuilds in and return the pipelines they replaced. Those may still be used by frames in flight, so the caller has to retire them
+    std::vector<VkPipeline> publishRebuilds();
+
+    // The compiled pipeline if it is ready, otherwise the fallback. Never blocks. Can return VK_NULL_HANDLE if there is no fallback, in which case the draw should be skipped
+    VkPipeline getPipeline(PipelineHandle handle) const;
+
+    // Like getPipeline, but when neither the pipeline nor a generated fallback is ready yet, waits for the fallback.
+    // That only happens in the first frame after a submit, and then only for as long as the unoptimized compile has left
+    VkPipeline waitForPipeline(PipelineHandle handle) const;
+
+    bool isReady(PipelineHandle handle) const;
+
+    // Future for the compiled pipeline, get() rethrows compile errors. For loading screens and tools that have to wait for the real pipeline
+    std::shared_future<VkPipeline> getFuture(PipelineHandle handle) const;
+
+    // Number of handles with a compile still running or queued, counting fallbacks and rebuilds. Shader modules a compile may be reading
+    // can only be destroyed once this is 0
+    uint32_t pendingCount() const;
+
+    // Waits for outstanding compiles and destroys every pipeline the compiler owns
+    void destroy();
+
+};
+
+#endif // PIPELINE_COMPILER_H
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef PIPELINE_DESC_H
+#define PIPELINE_DESC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Everything needed to build a graphics pipeline, stored by value. VkGraphicsPipelineCreateInfo is a tree of pointers into stack memory, so it can't be handed to another
+// thread or kept around for a later rebuild; this description can, and expands into the create info only at the moment the pipeline is created
+struct GraphicsPipelineDesc {
+
+    struct ShaderStage {
+        VkShaderStageFlagBits stage;
+        VkShaderModule module;
+        std::string entryPoint = "main";
+
+        // specialization constant values, the map entries point into the data. Empty uses the defaults declared in the shader
+        std::vector<VkSpecializationMapEntry> specializationEntries;
+        std::vector<uint8_t> specializationData;
+
+        // Set a 32-bit specialization constant (bool, int, uint or float), replacing its value if it was already set
+        void setSpecializationConstant(uint32_t constantId, uint32_t value);
+    };
+
+    std::vector<ShaderStage> stages;
+
+    // vertex input -- empty for shaders that generate their own vertices
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // rasterizer
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // depth testing, ignored when the subpass has no depth attachment
+    bool depthTest = false;
+    bool depthWrite = false;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+    // one entry per color attachment of the subpass
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
+
+    std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+
+    // Attachment formats of the subpass. Render passes with the same attachment formats and sample counts are compatible, so a pipeline built against one
+    // can be used with the others. Lets identical pipelines for different render passes be shared. Left empty, the render pass handle is used instead
+    std::vector<VkFormat> colorFormats;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+    VkPipelineCreateFlags flags = 0;
+
+    // Standard alpha blending for a single color attachment
+    static VkPipelineColorBlendAttachmentState alphaBlendAttachment();
+
+    // Build the pipeline. Thread safe as long as cache is either internally synchronized (the default) or only used by the calling thread
+    VkPipeline create(VkDevice logicalDevice, VkPipelineCache cache) const;
+
+};
+
+#endif // PIPELINE_DESC_H
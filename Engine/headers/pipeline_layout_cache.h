@@ -0,0 +1,76 @@
+#pragma once
+#ifndef PIPELINE_LAYOUT_CACHE_H
+#define PIPELINE_LAYOUT_CACHE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "shader_reflection.h"
+
+// The layout a set of shader stages needs, merged across the stages
+struct ReflectedLayout {
+    std::vector<VkDescriptorSetLayout> setLayouts; // indexed by set number, sets no stage uses get an empty layout
+    std::vector<VkPushConstantRange> pushConstantRanges;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+    // tightly packed 32-bit attributes in a single binding, in location order
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+};
+
+// Builds descriptor set layouts and pipeline layouts from shader reflection and caches them by content. Pipelines whose shaders declare the same
+// resources get the same VkDescriptorSetLayout and VkPipelineLayout handles, so their layouts are compatible and descriptor sets stay bound across pipeline switches
+class PipelineLayoutCache {
+
+private:
+
+    VkDevice logicalDevice;
+
+    // The contents are kept with each layout so a hash hit can be confirmed, a collision must never hand out a different layout
+    struct CachedSetLayout {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayout setLayout;
+    };
+
+    struct CachedPipelineLayout {
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        VkPipelineLayout pipelineLayout;
+    };
+
+    std::unordered_map<uint64_t, std::vector<CachedSetLayout>> setLayouts; // by content hash, more than one only if different contents collided
+    std::unordered_map<uint64_t, std::vector<CachedPipelineLayout>> pipelineLayouts;
+
+    struct ReservedSet {
+        VkDescriptorSetLayout setLayout;
+        std::vector<VkDescriptorType> bindingTypes; // indexed by binding number
+    };
+    std::unordered_map<uint32_t, ReservedSet> reservedSets; // by set number
+
+public:
+
+    PipelineLayoutCache(VkDevice& logicalDevice);
+
+    // Merge the stages' reflection into one layout. Bindings used by several stages get all of their stage flags, and the push constant blocks
+    // are merged into one range visible to every stage that declares one. Throws if two stages disagree about a binding's type, or if a runtime sized
+    // array is declared outside a reserved set, since only a reserved layout can say how many descriptors it holds
+    ReflectedLayout buildLayout(const std::vector<const ShaderReflection*>& stages);
+
+    // Give every shader that uses the set number this layout instead of one built from its reflection. For sets like the bindless table, whose runtime
+    // sized arrays and binding flags reflection can't know, or the view uniforms, whose dynamic offsets SPIR-V can't declare. A reserved dynamic buffer binding
+    // accepts the plain buffer type reflection reports. buildLayout throws if a shader declares a binding the layout doesn't have. The layout isn't owned by the cache
+    void reserveSet(uint32_t set, VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorType>& bindingTypes);
+
+    // bindings must be sorted by binding number
+    VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+
+    VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+    void destroy();
+
+};
+
+#endif // PIPELINE_LAYOUT_CACHE_H
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "pipeline_compiler.h"
+#include "pipeline_desc.h"
+
+// The parts of a GraphicsPipelineDesc that decide which pipeline it builds, in a canonical form so equal state compares equal.
+// Keys are compared field by field, the hash only picks the bucket
+struct PipelineStateKey {
+    struct Stage {
+        VkShaderStageFlagBits stage;
+        VkShaderModule module;
+        std::string entryPoint;
+        std::vector<std::pair<uint32_t, std::vector<uint8_t>>> constants; // constant ID -> value, sorted by ID. Pipelines that only differ in specialization are different pipelines
+    };
+
+    std::vector<Stage> stages;
+
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
+    std::vector<VkDynamicState> dynamicStates;
+
+    // attachment formats, which any compatible render pass shares. Without them, the render pass handle itself
+    std::vector<VkFormat> colorFormats;
+    VkFormat depthFormat;
+    VkRenderPass renderPass;
+
+    VkPipelineLayout layout;
+    uint32_t subpass;
+    VkPipelineCreateFlags flags;
+
+    VkPrimitiveTopology topology;
+    VkPolygonMode polygonMode;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkSampleCountFlagBits rasterizationSamples;
+
+    bool depthTest;
+    bool depthWrite;
+    VkCompareOp depthCompareOp;
+
+    bool operator==(const PipelineStateKey& other) const;
+};
+
+struct PipelineStateKeyHash {
+    size_t operator()(const PipelineStateKey& key) const;
+};
+
+// Hands out one shared pipeline per unique pipeline state. Materials that end up with identical state get the same PipelineHandle
+// instead of each compiling and holding on to their own copy, which keeps the pipeline count bounded by the number of distinct states
+class PipelineRegistry {
+
+private:
+
+    PipelineCompiler& pipelineCompiler;
+
+    std::unordered_map<PipelineStateKey, PipelineHandle, PipelineStateKeyHash> pipelines;
+    std::unordered_map<PipelineHandle, GraphicsPipelineDesc> descriptions; // kept so pipelines can be rebuilt when one of their shaders changes
+
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+
+public:
+
+    PipelineRegistry(PipelineCompiler& pipelineCompiler);
+
+    // The pipeline for desc's state, compiling it in the background the first time the state is seen
+    PipelineHandle getOrCreate(const GraphicsPipelineDesc& desc, VkPipeline fallback = VK_NULL_HANDLE);
+
+    // Rebuild every pipeline that uses oldModule with newModule in its place, in the background. Handles stay the same.
+    // The replaced pipelines come out of PipelineCompiler::publishRebuilds. Returns the number of pipelines being rebuilt
+    uint32_t rebuildPipelinesUsing(VkShaderModule oldModule, VkShaderModule newModule);
+
+    static PipelineStateKey makeKey(const GraphicsPipelineDesc& desc);
+
+    uint64_t getHitCount() const;
+
+    uint64_t getMissCount() const;
+
+    // Number of distinct pipelines
+    size_t size() const;
+
+};
+
+#endif // PIPELINE_REGISTRY_H
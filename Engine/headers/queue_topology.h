@@ -0,0 +1,56 @@
+#pragma once
+#ifndef QUEUE_TOPOLOGY_H
+#define QUEUE_TOPOLOGY_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Which queue family and queue every kind of work goes to. Dedicated families are preferred: a compute-only family runs async compute next to
+// graphics, a transfer-only family maps to the DMA engines. When a role has to share a family with another, it still gets a queue of its own if the
+// family offers more than one, so submissions don't serialize on one VkQueue. Roles only share a queue when the hardware leaves no other choice
+struct QueueTopology {
+
+    static constexpr uint32_t invalid = UINT32_MAX;
+
+    struct Slot {
+        uint32_t family = invalid;
+        uint32_t index = 0; // queue index within the family
+        float priority = 1.0f;
+    };
+
+    Slot graphics;
+    Slot present; // shares the graphics queue whenever the graphics family can present
+    bool presentRecordsCommands = true; // the present family also does graphics, compute or transfer work, so it can record barriers. A present-only family can't
+    Slot compute;
+    Slot transfer;
+
+    // family -> priority of each queue created in it, in queue index order
+    std::map<uint32_t, std::vector<float>> queuePriorities;
+
+    bool isComplete() const;
+
+    // compute or transfer work runs in a different family than graphics
+    bool hasDedicatedCompute() const;
+    bool hasDedicatedTransfer() const;
+
+    // Pick the families and queues for a device. surface is VK_NULL_HANDLE when nothing is presented, the present role then follows graphics
+    static QueueTopology select(VkPhysicalDevice device, VkSurfaceKHR surface);
+
+    // One create info per family used, pointing into queuePriorities. Only valid while this topology is alive
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos() const;
+
+};
+
+// The queues of a QueueTopology, once the device exists. Roles that share a queue hold the same handle
+struct DeviceQueues {
+    VkQueue graphics = VK_NULL_HANDLE;
+    VkQueue present = VK_NULL_HANDLE;
+    VkQueue compute = VK_NULL_HANDLE;
+    VkQueue transfer = VK_NULL_HANDLE;
+
+    static DeviceQueues get(VkDevice logicalDevice, const QueueTopology& topology);
+};
+
+#endif // QUEUE_TOPOLOGY_H
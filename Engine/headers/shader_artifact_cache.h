@@ -0,0 +1,30 @@
+#pragma once
+#ifndef SHADER_ARTIFACT_CACHE_H
+#define SHADER_ARTIFACT_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SPIR-V produced at runtime, stored on disk as <key>.spv so it survives between runs. The key must cover every input that produced the code
+class ShaderArtifactCache {
+
+private:
+
+    std::string cacheDirectory;
+
+    std::string artifactPath(uint64_t key) const;
+
+public:
+
+    ShaderArtifactCache(const std::string& cacheDirectory);
+
+    // Returns false if there is no artifact for the key or it is damaged
+    bool load(uint64_t key, std::vector<uint32_t>& code) const;
+
+    // Safe to call from several threads at once. Failing to write is not an error, the code just gets produced again next time
+    void store(uint64_t key, const std::vector<uint32_t>& code) const;
+
+};
+
+#endif // SHADER_ARTIFACT_CACHE_H
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <shaderc/shaderc.hpp>
+
+#include "shader_artifact_cache.h"
+#include "shader_optimizer.h"
+#include "thread_pool.h"
+
+// Inputs to a GLSL compile besides the source itself. Every field is part of the artifact cache key
+struct ShaderCompileOptions {
+    std::vector<std::pair<std::string, std::string>> defines; // name, value -- an empty value defines the macro without one
+    ShaderOptimization optimization = ShaderOptimization::None; // spirv-tools passes run over shaderc's output
+    bool debugInfo = false; // keep names and line info for debuggers and validation messages, stripped from the output otherwise
+    uint32_t targetVulkanVersion = VK_API_VERSION_1_0;
+
+    uint64_t hash() const;
+};
+
+// Compiles GLSL to SPIR-V at runtime with shaderc, in parallel on a thread pool. Results are stored in an on-disk artifact cache keyed by the hash
+// of the source, stage and options, so a shader is only compiled again when one of its inputs changes
+class ShaderCompiler {
+
+private:
+
+    ThreadPool& threadPool;
+    ShaderArtifactCache artifacts;
+
+    shaderc::Compiler compiler; // compiling is thread safe, one compiler is shared by all workers
+
+    std::atomic<uint64_t> cacheHits{ 0 };
+    std::atomic<uint64_t> cacheMisses{ 0 };
+
+public:
+
+    ShaderCompiler(ThreadPool& threadPool, const std::string& cacheDirectory);
+
+    // Compile on the calling thread, or load the result from the artifact cache. The artifact is the optimized code. Throws with the compiler's error message if the source doesn't compile
+    std::vector<uint32_t> compile(const std::string& sourcePath, VkShaderStageFlagBits stage, const ShaderCompileOptions& options);
+
+    // Compile on the thread pool
+    std::future<std::vector<uint32_t>> compileAsync(const std::string& sourcePath, VkShaderStageFlagBits stage, const ShaderCompileOptions& options);
+
+    // Shader stage from a GLSL file extension (.vert, .frag, .comp, ...)
+    static VkShaderStageFlagBits stageFromPath(const std::string& sourcePath);
+
+    static bool isSourcePath(const std::string& path);
+
+    uint64_t getCacheHits() const;
+
+    uint64_t getCacheMisses() const;
+
+};
+
+#endif // SHADER_COMPILER_H
@@ -2,24 +2,143 @@
 #ifndef SHADER_MANAGER_H
 #define SHADER_MANAGER_H
 
+#include <cstdint>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
 
+#include "shader_artifact_cache.h"
+#include "shader_compiler.h"
+#include "shader_optimizer.h"
+#include "shader_reflection.h"
+
+// Loads SPIR-V and owns the resulting shader modules. Modules are cached by the 128-bit hash of their contents, so every pipeline using the same shader shares one
+// VkShaderModule, and by path, so a file is only read once
 class ShaderManager {
 
 private:
 
     VkDevice logicalDevice;
 
+    // A hit is confirmed by the size and the upper half of a 128-bit content hash instead of a copy of the code, so a cached module costs no memory
+    // beyond its handle, and different code only gets the same module if all 128 bits collide
+    struct CachedModule {
+        VkShaderModule module;
+        size_t codeSize;
+        uint64_t hashHigh;
+    };
+
+    std::unordered_map<uint64_t, std::vector<CachedModule>> modulesByHash; // lower half of the content hash -> modules, more than one only if the lower halves collided
+    std::unordered_map<std::string, VkShaderModule> modulesByPath; // file path -> module of what was loaded from it
+    std::unordered_map<VkShaderModule, ShaderReflection> reflections; // every module is reflected once, when it is created
+
+    uint64_t cacheHits = 0;
+
+    // GLSL sources loaded through the runtime compiler. A source can be loaded with several option sets, each is its own entry
+    struct CompiledSource {
+        std::string sourcePath;
+        VkShaderStageFlagBits stage;
+        ShaderCompileOptions options;
+        uint64_t optionsHash;
+        VkShaderModule module;
+        uint64_t reloadCount = 0; // reloads started, only the latest one may replace the module
+    };
+
+    // Offline compiled SPIR-V is optimized on load, the result is cached by the hash of the file and the settings
+    std::unique_ptr<ShaderOptimizer> optimizer;
+    std::unique_ptr<ShaderArtifactCache> optimizedArtifacts;
+
+    std::unique_ptr<ShaderCompiler> compiler;
+    std::vector<CompiledSource> compiledSources;
+
+    std::vector<VkShaderModule> supersededModules; // replaced by a reload and no longer loaded from any path, waiting for takeSupersededModules
+
+    int findCompiledSource(const std::string& sourcePath, uint64_t optionsHash) const;
+
+    // Drop a module a reload replaced from the caches once no path or compiled source still loads it
+    void releaseIfUnused(VkShaderModule shaderModule);
+
+    std::vector<uint32_t> optimizeCode(const uint32_t* code, size_t codeSize);
+
 public:
 
     ShaderManager(VkDevice &logicalDevice);
 
+    // Load a compiled SPIR-V file. The file is memory mapped and its words are handed straight to the driver, no intermediate copy is made,
+    // unless optimization is enabled, in which case the driver gets the optimized artifact
+    VkShaderModule loadShaderModule(const std::string& filename);
+
+    // Module previously loaded from filename, or VK_NULL_HANDLE if the file hasn't been loaded
+    VkShaderModule getLoadedModule(const std::string& filename) const;
+
+    // Read a file again after it changed on disk. Returns the same module as before if the contents are identical.
+    // A previous module nothing else loads is handed out by takeSupersededModules rather than destroyed, pipelines may still be compiling from it
+    VkShaderModule reloadShaderModule(const std::string& filename);
+
+    // Create a module from SPIR-V words, or return the cached module if the same code was loaded before
+    VkShaderModule createShaderModule(const uint32_t* code, size_t codeSize);
+
+    // Throws if the size isn't a whole number of 32-bit words
     VkShaderModule createShaderModule(const std::vector<char>& code);
 
+    // Run the spirv-tools optimizer over every SPIR-V file loaded from now on. Optimized modules are cached in cacheDirectory
+    void enableOptimization(const ShaderOptimizerSettings& settings, const std::string& cacheDirectory);
+
+    // Compile GLSL at runtime, artifacts are cached in cacheDirectory. Needed by the GLSL functions below
+    void enableRuntimeCompilation(ThreadPool& threadPool, const std::string& cacheDirectory);
+
+    bool canCompileGLSL() const;
+
+    // Compile a GLSL file (or fetch it from the artifact cache) and create its module. The stage comes from the file extension
+    VkShaderModule loadGLSLModule(const std::string& sourcePath, const ShaderCompileOptions& options = {});
+
+    struct GLSLRequest {
+        std::string sourcePath;
+        ShaderCompileOptions options;
+    };
+
+    // Compile several GLSL files in parallel on the compiler's thread pool. Modules are returned in request order
+    std::vector<VkShaderModule> loadGLSLModules(const std::vector<GLSLRequest>& requests);
+
+    // A background recompile of a GLSL file that changed on disk, one per option set it was loaded with
+    struct GLSLReload {
+        size_t sourceIndex;
+        uint64_t reload; // which of the source's reloads this is
+        std::future<std::vector<uint32_t>> code;
+    };
+
+    // Start recompiling every variant of a loaded GLSL file. Returns nothing if the file wasn't loaded through the compiler
+    std::vector<GLSLReload> recompileGLSLAsync(const std::string& sourcePath);
+
+    // Create the module for a finished reload and return it, with the module it replaces in previousModule. Saves can overlap, so the module replaced is
+    // whatever the source has now rather than when the reload started, and a reload that a later one has overtaken returns VK_NULL_HANDLE and changes nothing.
+    // Rethrows the compile error if the new source didn't compile
+    VkShaderModule finishGLSLReload(GLSLReload& reload, VkShaderModule& previousModule);
+
+    // Modules replaced by reloads that the manager no longer caches or hands out. The caller owns them and destroys them once no pipeline
+    // compile can still be reading them
+    std::vector<VkShaderModule> takeSupersededModules();
+
+    // Descriptor bindings, push constants and vertex inputs of a module created by this manager
+    const ShaderReflection& getReflection(VkShaderModule shaderModule) const;
+
     static std::vector<char> readFile(const std::string& filename);
 
+    static uint64_t hashCode(const uint32_t* code, size_t codeSize);
+
+    // Number of load requests served from the cache without creating a new module
+    uint64_t getCacheHits() const;
+
+    // Number of distinct modules
+    size_t size() const;
+
+    // Destroy every cached module. Pipelines built from them stay valid
+    void destroy();
+
 };
 
-#endif // SHADER_MANAGER_H
\ No newline at end of file
+#endif // SHADER_MANAGER_H
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef SHADER_OPTIMIZER_H
+#define SHADER_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum class ShaderOptimization {
+    None,
+    Performance, // inlining, dead code elimination, constant folding, scalar replacement -- leaner code for the driver to compile and the GPU to run
+    Size // the passes that shrink the module the most, for shaders that are shipped or streamed
+};
+
+struct ShaderOptimizerSettings {
+    ShaderOptimization level = ShaderOptimization::None;
+    bool stripDebugInfo = false; // drop names, source text and line info, which the driver never needs
+    uint32_t targetVulkanVersion = VK_API_VERSION_1_0;
+
+    bool isEnabled() const;
+
+    uint64_t hash() const;
+};
+
+// Runs the spirv-tools optimizer over a module before the driver sees it. The shader interface (inputs, outputs, descriptors, push constants) is
+// preserved, so reflection and pipeline layouts don't change. Each call creates its own optimizer, so one ShaderOptimizer can be used from several threads
+class ShaderOptimizer {
+
+private:
+
+    ShaderOptimizerSettings settings;
+
+public:
+
+    ShaderOptimizer(const ShaderOptimizerSettings& settings);
+
+    // False when the build didn't find spirv-tools' optimizer libraries (SPIRV_TOOLS_OPTIMIZER isn't defined). optimize() throws in that case
+    static bool isAvailable();
+
+    // Throws with the validator's or optimizer's messages if the module can't be optimized
+    std::vector<uint32_t> optimize(const uint32_t* code, size_t codeSize) const;
+
+    const ShaderOptimizerSettings& getSettings() const;
+
+};
+
+#endif // SHADER_OPTIMIZER_H
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "pipeline_desc.h"
+#include "pipeline_registry.h"
+#include "shader_manager.h"
+
+// One material's pipeline with feature toggles. Each feature is a boolean specialization constant in the shaders, so a variant is the same modules
+// with different constant values instead of a separate shader, and the driver removes the code behind disabled features instead of branching on it per pixel.
+// Variants are only compiled when they are first asked for. A stage only receives the constants it declares, so feature combinations that make no
+// difference to any stage resolve to the same pipeline state and the registry hands out one shared pipeline for them
+class ShaderPermutationSet {
+
+public:
+
+    struct Feature {
+        std::string name;
+        uint32_t constantId; // layout(constant_id = N) const bool NAME in the shaders that implement the feature
+    };
+
+private:
+
+    PipelineRegistry& pipelineRegistry;
+    const ShaderManager& shaderManager;
+
+    GraphicsPipelineDesc baseDesc;
+    std::vector<Feature> features; // bit i of a feature mask toggles features[i]
+
+    std::unordered_map<uint64_t, PipelineHandle> variants; // effective feature mask -> pipeline
+
+    // Drop the features no stage declares, so masks that only differ in those share a cache entry
+    uint64_t effectiveMask(uint64_t featureMask) const;
+
+public:
+
+    ShaderPermutationSet(PipelineRegistry& pipelineRegistry, const ShaderManager& shaderManager, const GraphicsPipelineDesc& baseDesc, const std::vector<Feature>& features);
+
+    // Mask with the named features enabled. Throws on a name that wasn't declared
+    uint64_t getFeatureMask(const std::vector<std::string>& enabledFeatures) const;
+
+    // The pipeline for a feature combination, queued for compilation the first time the combination is asked for
+    PipelineHandle getVariant(uint64_t featureMask);
+
+    PipelineHandle getVariant(const std::vector<std::string>& enabledFeatures);
+
+    // The base description with the feature constants set for every stage that declares them
+    GraphicsPipelineDesc makeVariantDesc(uint64_t featureMask) const;
+
+    // Use newModule wherever the base description used oldModule, for variants created after a shader reload. Existing variants are rebuilt by the registry
+    void replaceModule(VkShaderModule oldModule, VkShaderModule newModule);
+
+    // Number of distinct feature combinations that have been requested
+    size_t size() const;
+
+};
+
+#endif // SHADER_PERMUTATIONS_H
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef SHADER_REFLECTION_H
+#define SHADER_REFLECTION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// The resource interface of one shader module, read from its SPIR-V with SPIRV-Cross: the descriptors it binds, the push constant block it reads
+// and, for vertex shaders, the vertex attributes it consumes. Pipeline layouts and vertex input state are derived from this instead of being written by hand
+struct ShaderReflection {
+
+    struct DescriptorBinding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count; // product of the array dimensions, 0 for runtime sized arrays
+    };
+
+    struct VertexInput {
+        uint32_t location;
+        VkFormat format; // the 32-bit format matching the shader's input type
+    };
+
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+    std::vector<DescriptorBinding> bindings;
+
+    uint32_t pushConstantOffset = 0;
+    uint32_t pushConstantSize = 0; // 0 if the shader has no push constant block
+
+    std::vector<VertexInput> vertexInputs; // sorted by location, empty for anything but vertex shaders
+
+    struct SpecializationConstant {
+        uint32_t constantId;
+        std::string name; // empty if the module's debug info was stripped
+    };
+
+    std::vector<SpecializationConstant> specializationConstants;
+
+    bool hasSpecializationConstant(uint32_t constantId) const;
+
+    // Reflect a SPIR-V module. Throws if the code can't be parsed
+    static ShaderReflection reflect(const uint32_t* code, size_t codeSize);
+
+};
+
+#endif // SHADER_REFLECTION_H
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches a directory for files being written on a background thread. On Linux this uses inotify, other platforms poll the files' modification times.
+// Changes are collected until the main thread picks them up with pollChanges, so the engine decides when reloading happens
+class ShaderWatcher {
+
+private:
+
+    std::string directory;
+
+    std::thread watchThread;
+    std::atomic<bool> running{ false };
+
+    std::mutex changesMutex;
+    std::set<std::string> changedPaths; // a set, editors often write a file several times when saving once
+
+    void watchLoop();
+    void recordChange(const std::string& path);
+
+public:
+
+    explicit ShaderWatcher(const std::string& directory);
+
+    // Stops and joins the watch thread
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // Paths (directory + file name) of the files that changed since the last call
+    std::vector<std::string> pollChanges();
+
+};
+
+#endif // SHADER_WATCHER_H
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads that run queued tasks, used for work that must never block the frame loop (pipeline and shader compilation)
+class ThreadPool {
+
+private:
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void workerLoop(int index);
+
+public:
+
+    explicit ThreadPool(uint32_t threadCount);
+
+    // Finishes the tasks that are already queued, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task and get a future for its result. Exceptions thrown by the task are rethrown from the future's get()
+    template<typename Task>
+    auto submit(Task task) -> std::future<std::invoke_result_t<Task>> {
+        using Result = std::invoke_result_t<Task>;
+
+        auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::move(task)); // shared so the copyable std::function can hold it
+        std::future<Result> future = packagedTask->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.emplace([packagedTask]() { (*packagedTask)(); });
+        }
+        condition.notify_one();
+
+        return future;
+    }
+
+    uint32_t size() const;
+
+    // Index of the worker the calling thread is, in [0, size()), or -1 when called from a thread that isn't part of a pool. Lets tasks use per-worker resources without locking
+    static int currentWorkerIndex();
+
+};
+
+#endif // THREAD_POOL_H
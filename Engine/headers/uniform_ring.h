@@ -0,0 +1,76 @@
+#pragma once
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <cstdint>
+#include <cstring>
+#include <vulkan/vulkan.h>
+
+#include "gpu_allocator.h"
+
+// Per-frame uniform data in one persistently mapped buffer, split into a region per frame in flight. Callers bump-allocate slices aligned to
+// minUniformBufferOffsetAlignment, write them through the mapping and bind them with a dynamic offset into a set that points at the whole buffer, so
+// a uniform update costs no allocation, no map or unmap and no descriptor write. Data up to the 128 bytes every device guarantees belongs in push constants instead
+class UniformRing {
+
+public:
+
+    // A slice of the frame's region, offset is what to pass as the dynamic offset
+    struct Slice {
+        uint32_t offset;
+        void* data;
+    };
+
+    struct Stats {
+        VkDeviceSize bytesPerFrame = 0;
+        VkDeviceSize peakFrameBytes = 0; // most any frame has used, including alignment padding
+        uint64_t slicesAllocated = 0;
+    };
+
+private:
+
+    VkDevice logicalDevice;
+    GpuAllocator& gpuAllocator;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    GpuAllocation memory; // persistently mapped
+
+    VkDeviceSize alignment;
+    VkDeviceSize regionSize; // bytes per frame in flight
+    VkDeviceSize regionBegin = 0; // region of the frame being recorded
+    VkDeviceSize head = 0; // where the next slice goes
+
+    Stats stats;
+
+public:
+
+    // bytesPerFrame is rounded up to the alignment
+    UniformRing(VkDevice& logicalDevice, GpuAllocator& gpuAllocator, VkPhysicalDevice physicalDevice, VkDeviceSize bytesPerFrame, uint32_t framesInFlight);
+
+    // Start filling the frame's region over. Only call once the fence of the frame that last used the slot has signaled
+    void beginFrame(uint32_t frame);
+
+    // Reserve size bytes of the frame's region. Throws if the region is full
+    Slice allocate(VkDeviceSize size);
+
+    // Copy value into a new slice and return its dynamic offset
+    template<typename T>
+    uint32_t push(const T& value) {
+        Slice slice = allocate(sizeof(T));
+        std::memcpy(slice.data, &value, sizeof(T));
+        return slice.offset;
+    }
+
+    // Make the frame's writes visible to the GPU, call before submitting. A no-op on coherent memory
+    void flush();
+
+    // The descriptor points here with a range of the largest slice a shader reads, the dynamic offset picks the slice
+    VkBuffer getBuffer() const;
+
+    const Stats& getStats() const;
+
+    void destroy();
+
+};
+
+#endif // UNIFORM_RING_H
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef UPLOAD_MANAGER_H
+#define UPLOAD_MANAGER_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "gpu_allocator.h"
+
+// Copies that have landed on the transfer queue and now belong to the graphics queue. The graphics submit that uses the data has to wait on the semaphores
+// and record the acquire barriers (UploadManager::recordAcquire) before anything reads the uploaded resources
+struct UploadHandoff {
+    std::vector<VkSemaphore> semaphores;
+    VkPipelineStageFlags waitStage = 0; // where the graphics queue first touches the uploaded data
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+
+    bool empty() const;
+};
+
+// Streams data to GPU-only resources through a persistently mapped staging ring buffer. Copies are batched into one command buffer and submitted to
+// the transfer queue, which on most discrete GPUs is a separate DMA engine that runs alongside rendering. When the transfer queue belongs to another
+// family than graphics, ownership of the destination is released on the transfer queue and acquired on the graphics queue
+class UploadManager {
+
+private:
+
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE; // signaled when the copies are done and the batch's staging space can be reused
+        VkSemaphore semaphore = VK_NULL_HANDLE; // waited on by the graphics queue
+        VkDeviceSize ringEnd = 0; // ring position after the batch's last copy
+        VkDeviceSize ringBytes = 0; // staging bytes used by the batch, including padding at the end of the ring
+    };
+
+    struct RetiredSemaphore {
+        VkSemaphore semaphore;
+        uint64_t frame; // frame that waited on it, the semaphore can be reused once that frame has finished
+    };
+
+    VkDevice logicalDevice;
+    GpuAllocator& gpuAllocator;
+
+    uint32_t transferFamily;
+    uint32_t graphicsFamily;
+    VkQueue transferQueue;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    GpuAllocation stagingMemory;
+    VkDeviceSize ringSize;
+    VkDeviceSize ringHead = 0; // where the next copy is staged
+    VkDeviceSize ringTail = 0; // start of the oldest staging data still being copied from
+    VkDeviceSize ringUsed = 0;
+
+    Batch recording; // the batch copies are currently recorded into, its command buffer is null until the first copy
+    UploadHandoff recordingHandoff; // acquire barriers for the recording batch, moved to pendingHandoff when it is submitted
+    std::deque<Batch> inFlight; // submitted, in submission order
+    std::vector<Batch> freeBatches;
+    std::vector<VkSemaphore> freeSemaphores;
+    std::vector<RetiredSemaphore> retiredSemaphores;
+
+    UploadHandoff pendingHandoff; // submitted batches the graphics queue hasn't picked up yet
+
+    uint64_t bytesUploaded = 0;
+    uint64_t batchesSubmitted = 0;
+    uint64_t ringStalls = 0; // times the CPU had to wait for the transfer queue to free staging space
+
+    VkDeviceSize stage(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+    bool tryReserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    void beginBatch();
+    void reclaim(bool wait);
+
+public:
+
+    // ringSize bytes of staging memory are allocated up front. transferQueue may be the graphics queue if the device has no separate transfer family
+    UploadManager(VkDevice& logicalDevice, GpuAllocator& gpuAllocator, uint32_t transferFamily, VkQueue transferQueue, uint32_t graphicsFamily, VkDeviceSize ringSize = 32ull * 1024 * 1024);
+
+    // Copy data into a buffer. dstStage and dstAccess describe how the graphics queue will use it. Uploads larger than the ring are split
+    void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+        VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VkAccessFlags dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+
+    // Copy tightly packed texels into mip 0, layer 0 of an image whose contents can be discarded, leaving it in finalLayout. Must fit in the ring
+    void uploadImage(VkImage image, VkExtent3D extent, VkImageAspectFlags aspect, const void* data, VkDeviceSize size, VkImageLayout finalLayout,
+        VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT);
+
+    // Submit the copies recorded so far to the transfer queue
+    void submit();
+
+    // Submit what is left and hand everything submitted since the last call to the graphics frame frameNumber
+    UploadHandoff takeHandoff(uint64_t frameNumber);
+
+    // Record the graphics queue side of the handoff: the acquire barriers, or plain barriers if both queues are in the same family
+    static void recordAcquire(VkCommandBuffer commandBuffer, const UploadHandoff& handoff);
+
+    // Reuse the staging space of finished batches and the semaphores of finished frames
+    void collect(uint64_t completedFrames);
+
+    uint64_t getBytesUploaded() const;
+
+    uint64_t getBatchesSubmitted() const;
+
+    uint64_t getRingStalls() const;
+
+    bool usesDedicatedQueue() const;
+
+    // Waits for the transfer queue, then frees everything
+    void destroy();
+
+};
+
+#endif // UPLOAD_MANAGER_H
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "shader_reflection.h"
+
+// Shader input locations of the vertex attributes. Vertex shaders declare the attributes they read at these locations
+enum class VertexAttribute : uint32_t {
+    Position = 0,
+    Normal = 1,
+    Tangent = 2, // xyz direction, w the bitangent sign
+    TexCoord = 3,
+    Color = 4
+};
+
+enum class PositionEncoding {
+    Float32, // 12 bytes
+    Half, // 8 bytes, half floats with their precision relative to the distance from the origin
+    Snorm16 // 8 bytes, 16 bits spread evenly over the mesh bounds, decoded with the mesh's scale and offset
+};
+
+// Unit vectors -- normals and tangents
+enum class DirectionEncoding {
+    Float32, // 12 bytes for normals, 16 for tangents
+    Octahedral16, // 4 bytes for normals, 8 for tangents. The sphere is folded onto a square, which spends the bits evenly over all directions
+    Octahedral8 // 2 bytes for normals, 4 for tangents, enough for smooth shading but visibly banded on shiny surfaces
+};
+
+enum class TexCoordEncoding {
+    Float32, // 8 bytes
+    Half, // 4 bytes
+    Unorm16 // 4 bytes, 16 bits spread evenly over the mesh's UV range, decoded with the mesh's scale and offset
+};
+
+enum class ColorEncoding {
+    None,
+    Float32, // 16 bytes
+    Unorm8 // 4 bytes
+};
+
+enum class IndexEncoding {
+    Automatic, // 16-bit indices when the vertices fit, 32-bit otherwise
+    Uint16,
+    Uint32
+};
+
+// How each attribute of a vertex is stored. Vertex fetch bandwidth is what limits dense meshes, and the compact encodings cut a vertex to less than half
+// of its full precision size. Attributes are interleaved in a single binding in location order, and the shader sees every encoding as plain floats
+struct VertexFormat {
+
+    struct Attribute {
+        VertexAttribute attribute;
+        VkFormat format;
+        uint32_t offset;
+    };
+
+    PositionEncoding position = PositionEncoding::Snorm16;
+    DirectionEncoding direction = DirectionEncoding::Octahedral16; // normals and tangents
+    bool tangents = false; // only meshes with normal maps need them
+    TexCoordEncoding texCoord = TexCoordEncoding::Unorm16;
+    ColorEncoding color = ColorEncoding::Unorm8;
+    IndexEncoding index = IndexEncoding::Automatic;
+
+    // The same attributes at full precision with 32-bit indices, the baseline the compact encodings are measured against
+    VertexFormat fullPrecision() const;
+
+    // Attributes in location order. Each one starts on a 4-byte boundary, so shaders that fetch vertices from a storage buffer can read them as whole words
+    std::vector<Attribute> attributes() const;
+
+    // Bytes per vertex
+    uint32_t stride() const;
+
+    // 16 or 32-bit indices for a mesh with vertexCount vertices. Throws if 16-bit indices are asked for but can't address every vertex
+    VkIndexType indexType(uint32_t vertexCount) const;
+
+    // Whether normals and tangents are octahedral, which the vertex shader has to decode. Passed to it as a specialization constant
+    bool octahedralDirections() const;
+
+    // The vertex input state for a vertex shader. Only attributes the shader reads get a description, and a shader input the format doesn't
+    // store throws. Formats come from the encoding rather than from the shader, which declares every attribute as 32-bit floats
+    void describe(const ShaderReflection& vertexStage, std::vector<VkVertexInputBindingDescription>& bindings, std::vector<VkVertexInputAttributeDescription>& attributes) const;
+
+};
+
+#endif // VERTEX_FORMAT_H
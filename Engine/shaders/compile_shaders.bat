@@ -5,6 +5,14 @@ set "ROOT_DIR=%~dp0"
 cd /d "%ROOT_DIR%"
 @echo on
 
-"%VULKAN_DIR%\glslc.exe" "%ROOT_DIR%\shader.vert" -o vert.spv
-"%VULKAN_DIR%\glslc.exe" "%ROOT_DIR%\shader.frag" -o frag.spv
-pause
\ No newline at end of file
+"%VULKAN_DIR%\glslc.exe" -O "%ROOT_DIR%\shader.vert" -o vert.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O "%ROOT_DIR%\shader.frag" -o frag.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O "%ROOT_DIR%\meshlet_cull.comp" -o meshlet_cull.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O --target-env=vulkan1.2 "%ROOT_DIR%\meshlet.task" -o meshlet_task.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O --target-env=vulkan1.2 "%ROOT_DIR%\meshlet.mesh" -o meshlet_mesh.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O "%ROOT_DIR%\instanced.vert" -o instanced_vert.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O -DBINDLESS "%ROOT_DIR%\instanced.vert" -o instanced_bindless_vert.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O "%ROOT_DIR%\instance_cull.comp" -o instance_cull.spv || exit /b 1
+"%VULKAN_DIR%\glslc.exe" -O "%ROOT_DIR%\depth_reduce.comp" -o depth_reduce.spv || exit /b 1
+@rem the build passes nopause, it can't answer the prompt
+if not "%~1"=="nopause" pause
@@ -1,2 +1,14 @@
-../../Dependencies/VulkanSDK/Bin/glslc shader.vert -o vert.spv
-../../Dependencies/VulkanSDK/Bin/glslc shader.frag -o frag.spv
\ No newline at end of file
+#!/bin/sh
+# Run by the build before the engine is compiled, and by hand after editing a shader
+set -e
+cd "$(dirname "$0")"
+
+../../Dependencies/VulkanSDK/Bin/glslc -O shader.vert -o vert.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O shader.frag -o frag.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O meshlet_cull.comp -o meshlet_cull.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O --target-env=vulkan1.2 meshlet.task -o meshlet_task.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O --target-env=vulkan1.2 meshlet.mesh -o meshlet_mesh.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O instanced.vert -o instanced_vert.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O instance_cull.comp -o instance_cull.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O depth_reduce.comp -o depth_reduce.spv
+../../Dependencies/VulkanSDK/Bin/glslc -O -DBINDLESS instanced.vert -o instanced_bindless_vert.spv
@@ -0,0 +1,63 @@
+#version 450
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+layout(constant_id = 1) const bool OCTAHEDRAL_DIRECTIONS = true; // normals are stored octahedral encoded in two components, set from the engine's vertex format
+
+layout(push_constant) uniform SceneConstants {
+    vec3 positionScale; // position = stored position * scale + offset, undoes the quantization to the mesh bounds
+    uint instanceBuffer; // index of the instances in the bindless table, BINDLESS only
+    vec4 positionOffset;
+    vec4 texCoordScaleOffset; // the same for texture coordinates, xy is the scale and zw the offset
+} scene;
+
+// shared by every draw of the frame, a slice of the engine's uniform ring bound with a dynamic offset
+layout(set = 2, binding = 0) uniform View {
+    mat4 viewProjection; // world to clip space
+    vec4 cameraPosition; // world space, the light sits at the camera
+} view;
+
+// one entry per object in the scene, the draw's first instance picks it
+struct Instance {
+    mat4 model; // rotation, uniform scale and translation
+    vec4 bounds; // world space bounding sphere, xyz center and w radius
+};
+
+#ifdef BINDLESS
+layout(std430, set = 1, binding = 1) readonly buffer Instances { Instance instances[]; } bindlessBuffers[]; // the engine's bindless table, see bindless_table.h
+#define INSTANCES bindlessBuffers[scene.instanceBuffer].instances
+#else
+layout(std430, set = 0, binding = 0) readonly buffer Instances { Instance instances[]; };
+#define INSTANCES instances
+#endif
+
+// every attribute is read as floats whatever its encoding, the vertex fetch converts
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 3) in vec2 inTexCoord;
+layout(location = 4) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0) { // fold the corners of the square back onto the lower half
+        direction.xy = (1.0 - abs(direction.yx)) * vec2(direction.x >= 0.0 ? 1.0 : -1.0, direction.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(direction);
+}
+
+void main() {
+    mat4 model = INSTANCES[gl_InstanceIndex].model;
+
+    vec3 position = (model * vec4(inPosition * scene.positionScale + scene.positionOffset.xyz, 1.0)).xyz;
+    vec3 normal = normalize(mat3(model) * (OCTAHEDRAL_DIRECTIONS ? octahedralDecode(inNormal.xy) : inNormal)); // the scale is uniform, so the model matrix works for normals too
+    vec2 texCoord = inTexCoord * scene.texCoordScaleOffset.xy + scene.texCoordScaleOffset.zw;
+
+    float checker = mod(floor(texCoord.x * 16.0) + floor(texCoord.y * 8.0), 2.0);
+    float diffuse = max(dot(normal, normalize(view.cameraPosition.xyz - position)), 0.0);
+
+    gl_Position = view.viewProjection * vec4(position, 1.0);
+    fragColor = inColor.rgb * (0.2 + 0.8 * diffuse) * mix(0.75, 1.0, checker);
+}
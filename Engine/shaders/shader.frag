@@ -1,9 +1,15 @@
 #version 450
 
+layout(constant_id = 0) const bool GRAYSCALE = false; // material feature, set per pipeline variant
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if (GRAYSCALE) {
+        color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+    }
+    outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -1,20 +1,39 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+layout(constant_id = 1) const bool OCTAHEDRAL_DIRECTIONS = true; // normals are stored octahedral encoded in two components, set from the engine's vertex format
+
+layout(push_constant) uniform MeshConstants {
+    mat4 transform; // model to clip space
+    vec4 positionScale; // position = stored position * scale + offset, undoes the quantization to the mesh bounds
+    vec4 positionOffset;
+    vec4 texCoordScaleOffset; // the same for texture coordinates, xy is the scale and zw the offset
+    vec4 cameraPosition; // model space, the light sits at the camera
+} mesh;
+
+// every attribute is read as floats whatever its encoding, the vertex fetch converts
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 3) in vec2 inTexCoord;
+layout(location = 4) in vec4 inColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+layout(location = 0) out vec3 fragColor;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0) { // fold the corners of the square back onto the lower half
+        direction.xy = (1.0 - abs(direction.yx)) * vec2(direction.x >= 0.0 ? 1.0 : -1.0, direction.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(direction);
+}
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    vec3 position = inPosition * mesh.positionScale.xyz + mesh.positionOffset.xyz;
+    vec3 normal = OCTAHEDRAL_DIRECTIONS ? octahedralDecode(inNormal.xy) : normalize(inNormal);
+    vec2 texCoord = inTexCoord * mesh.texCoordScaleOffset.xy + mesh.texCoordScaleOffset.zw;
+
+    float checker = mod(floor(texCoord.x * 16.0) + floor(texCoord.y * 8.0), 2.0);
+    float diffuse = max(dot(normal, normalize(mesh.cameraPosition.xyz - position)), 0.0);
+
+    gl_Position = mesh.transform * vec4(position, 1.0);
+    fragColor = inColor.rgb * (0.2 + 0.8 * diffuse) * mix(0.75, 1.0, checker);
+}
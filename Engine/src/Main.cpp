@@ -21,9 +21,228 @@ public:
 		const bool enableValidationLayers = true;
 	#endif
 
+	// Counters describing how well the CPU and GPU are overlapping
+	struct FrameStats {
+		uint64_t framesSubmitted = 0; // total number of frames recorded and submitted to the GPU
+		uint64_t fenceWaits = 0; // number of times the CPU had to block because the GPU was still using the frame's resources
+		double fenceWaitMilliseconds = 0.0; // total time the CPU spent blocked on those fences
+		uint64_t drawCalls = 0; // draw commands recorded by the CPU, an indirect draw counts once however many draws the GPU expands it to
+	};
+
+	// Set how many frames the CPU may record ahead of the GPU. Must be called before run()
+	void setFramesInFlight(uint32_t count) {
+		if (count == 0) {
+			throw std::runtime_error("frames in flight must be at least 1!");
+		}
+		framesInFlight = count;
+	}
+
+	const FrameStats& getFrameStats() const {
+		return frameStats;
+	}
+
+	// Choose how finished frames are handed to the display: IMMEDIATE (no Vsync, tearing, lowest latency), MAILBOX (no tearing, newest frame wins),
+	// FIFO (regular Vsync, always supported, lowest power) or FIFO_RELAXED (Vsync that tears instead of stuttering when a frame is late).
+	// Can be called at any time, a running swap chain is recreated with the new mode. Falls back to FIFO if the device doesn't support the mode
+	void setPresentMode(VkPresentModeKHR mode) {
+		if (mode != VK_PRESENT_MODE_IMMEDIATE_KHR && mode != VK_PRESENT_MODE_MAILBOX_KHR && mode != VK_PRESENT_MODE_FIFO_KHR && mode != VK_PRESENT_MODE_FIFO_RELAXED_KHR) {
+			throw std::runtime_error("unsupported present mode requested!");
+		}
+		preferredPresentMode = mode;
+		presentModeChanged = swapChain != VK_NULL_HANDLE; // nothing to recreate if the swap chain doesn't exist yet
+	}
+
+	// The present mode of the current swap chain, which may differ from the requested one if it wasn't supported
+	VkPresentModeKHR getPresentMode() const {
+		return swapChainPresentMode;
+	}
+
+	// Cap the frame rate, 0 for unlimited
+	void setTargetFrameRate(double framesPerSecond) {
+		framePacer.setTargetFrameRate(framesPerSecond);
+	}
+
+	const FramePacer& getFramePacer() const {
+		return framePacer;
+	}
+
+	// Submit to GPU completion, and to the display where the driver reports it. Valid until the engine is destroyed
+	const LatencyMonitor& getLatencyMonitor() const {
+		return *latencyMonitor;
+	}
+
+	// Watch the shader directory and rebuild the affected shader modules and pipelines when a compiled shader changes. Must be called before run()
+	void setShaderHotReload(bool enabled) {
+		shaderHotReload = enabled;
+	}
+
+	// Compile the GLSL sources at runtime instead of loading the SPIR-V produced by compile_shaders. Must be called before run()
+	void setRuntimeShaderCompilation(bool enabled) {
+		runtimeShaderCompilation = enabled;
+	}
+
+	// Optimize shaders with spirv-tools before they reach the driver. Applies to both offline compiled and runtime compiled shaders. Must be called before run()
+	void setShaderOptimization(ShaderOptimization level) {
+		shaderOptimization = level;
+	}
+
+	// Turn on a material feature of the triangle, e.g. GRAYSCALE. Features are specialization constants, so each combination is its own pipeline. Must be called before run()
+	void enableShaderFeature(const std::string& name) {
+		triangleFeatures.push_back(name);
+	}
+
+	// How the mesh's vertex attributes and indices are stored. The compact encodings are the default, fullPrecision() is the baseline. Must be called before run()
+	void setVertexFormat(const VertexFormat& format) {
+		vertexFormat = format;
+	}
+
+	const VertexFormat& getVertexFormat() const {
+		return vertexFormat;
+	}
+
+	// Draw a mesh file (OBJ) instead of the generated sphere. Must be called before run()
+	void setMeshPath(const std::string& path) {
+		meshPath = path;
+	}
+
+	// Run the asset cook step for a mesh file without starting the engine: optimize it and store it in the mesh cache, where run() picks it up
+	MeshCooker::Result cookMesh(const std::string& path) const {
+		return MeshCooker(meshCacheDirectory).cookFile(path);
+	}
+
+	// How the mesh reaches the rasterizer
+	enum class GeometryPath {
+		Automatic, // MeshShader where the device supports it, ClusterCulling otherwise
+		Indexed, // the whole index buffer, every triangle is rasterized
+		ClusterCulling, // a compute pass culls meshlets and compacts the surviving triangles into an indirect draw
+		MeshShader // a task shader culls meshlets and a mesh shader emits the rest, needs VK_EXT_mesh_shader
+	};
+
+	// Must be called before run(). Asking for MeshShader on a device that doesn't support it falls back to ClusterCulling
+	void setGeometryPath(GeometryPath path) {
+		requestedGeometryPath = path;
+	}
+
+	// The path chosen for the device, valid once the engine has been initialized
+	GeometryPath getGeometryPath() const {
+		return geometryPath;
+	}
+
+	// Draw a grid of copies of the mesh, each with its own transform, instead of a single one. Scenes take the indexed geometry path with one draw per
+	// visible instance, issued by the CPU unless GPU-driven rendering is on. Must be called before run()
+	void setSceneInstanceCount(uint32_t count) {
+		sceneInstanceCount = count;
+	}
+
+	// Cull the scene's instances in compute passes and draw the survivors with vkCmdDrawIndexedIndirectCount, so the CPU's cost stops growing with the
+	// object count. Instances hidden behind others are culled too, against a depth pyramid in two phases. Needs a Vulkan 1.2 device with drawIndirectCount,
+	// the CPU issues the draws otherwise. Must be called before run()
+	void setGpuDrivenRendering(bool enabled) {
+		requestedGpuDriven = enabled;
+	}
+
+	// Whether the scene is culled and drawn by the GPU, valid once the engine has been initialized
+	bool usesGpuDrivenRendering() const {
+		return gpuDriven;
+	}
+
+	// Reach the scene's resources through the bindless table, indexed with push constants, instead of binding per-resource descriptor sets.
+	// Needs a Vulkan 1.2 device with descriptor indexing, the sets are bound as before otherwise. Must be called before run()
+	void setBindlessResources(bool enabled) {
+		requestedBindless = enabled;
+	}
+
+	// Whether the bindless table is in use, valid once the engine has been initialized
+	bool usesBindlessResources() const {
+		return bindless;
+	}
+
+	// Only valid when usesBindlessResources() is true
+	const BindlessTable& getBindlessTable() const {
+		return *bindlessTable;
+	}
+
+	// Pools and sets handed out by the descriptor allocator, valid once the engine has been initialized
+	const DescriptorAllocator::Stats& getDescriptorStats() const {
+		return descriptorAllocator->getStats();
+	}
+
+	// How much of the uniform ring the frames use, valid once the engine has been initialized
+	const UniformRing::Stats& getUniformStats() const {
+		return uniformRing->getStats();
+	}
+
+	// Size of the mesh on the GPU, valid once the engine has been initialized
+	struct MeshStats {
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		uint32_t meshletCount = 0; // 0 on the indexed path
+		uint32_t instanceCount = 0; // copies of the mesh in the scene, 0 when a single mesh is drawn
+		uint32_t vertexStride = 0;
+		uint32_t fullPrecisionStride = 0; // what the same vertex takes with every attribute as 32-bit floats
+		uint32_t indexSize = 0; // 2 or 4 bytes
+		VertexCacheStats sourceCache; // post-transform cache efficiency of the source's triangle order
+		VertexCacheStats cookedCache; // and after the mesh optimizer
+		bool cookedEarlier = false; // loaded from the mesh cache instead of being optimized during startup
+	};
+
+	const MeshStats& getMeshStats() const {
+		return meshStats;
+	}
+
+	// Data streamed to the GPU through the staging ring, as it was when rendering stopped
+	struct UploadStats {
+		uint64_t bytesUploaded = 0;
+		uint64_t batchesSubmitted = 0;
+		uint64_t ringStalls = 0;
+		bool dedicatedQueue = false;
+	};
+
+	const UploadStats& getUploadStats() const {
+		return uploadStats;
+	}
+
+	// Device memory usage and fragmentation per heap, as it was when rendering stopped
+	const std::vector<GpuAllocator::HeapStats>& getMemoryStats() const {
+		return memoryStats;
+	}
+
+	// The queue families and queues chosen for each kind of work, valid once the engine has been initialized
+	const QueueTopology& getQueueTopology() const {
+		return queueTopology;
+	}
+
+	// Pipeline deduplication counters, valid once the engine has been initialized
+	const PipelineRegistry& getPipelineRegistry() const {
+		return *pipelineRegistry;
+	}
+
+	// A finished frame copied back to host memory in headless mode
+	struct FrameReadback {
+		uint64_t frameNumber; // index of the frame in submission order
+		uint32_t width;
+		uint32_t height;
+		uint32_t rowPitch; // bytes between the start of two rows
+		VkFormat format;
+		const uint8_t* pixels; // only valid for the duration of the callback
+	};
+
+	// Render without a window or surface into engine-owned images, for machines without a display. Runs for frameCount frames and then exits. Must be called before run()
+	void enableHeadless(uint64_t frameCount) {
+		headless = true;
+		headlessFrameCount = frameCount;
+	}
+
+	// Called with every frame rendered in headless mode once the GPU has finished it and the copy to host memory has landed
+	void setReadbackCallback(std::function<void(const FrameReadback&)> callback) {
+		readbackCallback = std::move(callback);
+	}
+
 	// initialize the window and vulkan to start the engine
     void run() {
-		initWindow();
+		if (!headless) { // headless mode never touches GLFW so it can run on machines without a display
+			initWindow();
+		}
 		initVulkan();
 		mainLoop();
 		cleanup();
@@ -33,85 +252,503 @@ private:
     GLFWwindow* window;
 	VkInstance instance;
 
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0; // the highest version up to 1.2 the loader supports
+
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 
 	const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
 
+	bool headless = false;
+	uint64_t headlessFrameCount = 0;
+	std::function<void(const FrameReadback&)> readbackCallback;
+	std::vector<GpuAllocation> offscreenImageMemory; // backing memory of the engine-owned render targets used in place of swap chain images in headless mode
+
 	VkDevice logicalDevice;
 
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue computeQueue; // async compute, the graphics queue if the device has no other compute queue
+	VkQueue transferQueue; // the graphics queue if the device has no separate transfer family
+
+	QueueTopology queueTopology; // chosen when the logical device is created
+
+	// present queue side of the swap chain image ownership transfer, only used when graphics and present are different families
+	VkCommandPool presentCommandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> presentAcquireCommandBuffers; // one per swap chain image
 	
 	VkSurfaceKHR surface;
 
-	VkSwapchainKHR swapChain;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageViews;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
+	// Signaled when an image's rendering is done, and with an ownership transfer when the present queue has taken it over. Per image rather than per frame:
+	// a frame's fence doesn't say whether the presentation engine has waited on its semaphore yet, getting the image back from vkAcquireNextImageKHR does
+	std::vector<VkSemaphore> renderFinishedSemaphores;
+	std::vector<VkSemaphore> presentAcquiredSemaphores; // only used when graphics and present families differ
+	VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+	VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR; // triple buffering by default
+	bool presentModeChanged = false; // set when the user picks a new present mode so the swap chain is recreated after the current frame
 
 	VkRenderPass renderPass;
-	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	VkPipelineLayout pipelineLayout; // owned by the pipeline layout cache
+	VkShaderStageFlags pushConstantStages = 0; // every stage that reads the mesh push constants in the triangle pipeline
+	PipelineHandle trianglePipeline;
+	std::unique_ptr<ShaderPermutationSet> trianglePermutations; // feature variants of the triangle pipeline, compiled when first used
+	std::vector<std::string> triangleFeatures;
+
+	std::unique_ptr<GpuAllocator> gpuAllocator; // every resource's device memory is sub-allocated from here
+	std::vector<GpuAllocator::HeapStats> memoryStats; // taken once rendering has stopped, before anything is freed
+	std::unique_ptr<UploadManager> uploadManager; // streams data to device local resources on the transfer queue
+	UploadHandoff frameUploads; // uploads the frame being recorded has to wait for
+	UploadStats uploadStats;
+
+	// Must match the push constant block of shader.vert
+	struct MeshPushConstants {
+		glm::mat4 transform;
+		glm::vec3 positionScale;
+		uint32_t instanceBuffer; // bindless table index of the scene's instances, copied into ScenePushConstants. The other shaders see it as positionScale.w and ignore it
+		glm::vec4 positionOffset;
+		glm::vec4 texCoordScaleOffset;
+		glm::vec4 cameraPosition;
+	};
+	static_assert(sizeof(MeshPushConstants) <= 128, "every device supports 128 bytes of push constants, larger data goes through the uniform ring");
+
+	// Must match the push constant block of instanced.vert -- what each scene draw needs, the view they share comes from the uniform ring
+	struct ScenePushConstants {
+		glm::vec3 positionScale;
+		uint32_t instanceBuffer;
+		glm::vec4 positionOffset;
+		glm::vec4 texCoordScaleOffset;
+	};
+	static_assert(sizeof(ScenePushConstants) <= 128, "every device supports 128 bytes of push constants, larger data goes through the uniform ring");
+
+	// Must match the View block of instanced.vert
+	struct ViewUniforms {
+		glm::mat4 viewProjection;
+		glm::vec4 cameraPosition; // world space
+	};
+
+	// A mesh in device local memory, filled through the upload manager
+	struct GpuMesh {
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		GpuAllocation vertexMemory;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		GpuAllocation indexMemory;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		uint32_t indexCount = 0;
+		MeshPushConstants constants{}; // the decode scale and offset, the transform is filled in per frame
+		glm::mat4 fit = glm::mat4(1.0f); // centers the mesh and scales it to a unit sphere
+
+		// the meshlets and their bounds, read by the culling shaders on the cluster culling and mesh shader paths
+		VkBuffer meshletBuffer = VK_NULL_HANDLE;
+		GpuAllocation meshletMemory;
+		VkBuffer meshletBoundsBuffer = VK_NULL_HANDLE;
+		GpuAllocation meshletBoundsMemory;
+		VkBuffer meshletVertexBuffer = VK_NULL_HANDLE;
+		GpuAllocation meshletVertexMemory;
+		VkBuffer meshletTriangleBuffer = VK_NULL_HANDLE;
+		GpuAllocation meshletTriangleMemory;
+		uint32_t meshletCount = 0;
+	};
+
+	GeometryPath requestedGeometryPath = GeometryPath::Automatic;
+	GeometryPath geometryPath = GeometryPath::Indexed; // chosen for the device when the logical device is created
+	PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasks = nullptr; // extension entry point, loaded on the mesh shader path
+	const uint32_t meshletsPerTask = 32; // local size of meshlet.task, each of its workgroups culls this many meshlets
+
+	VkPipeline clusterCullPipeline = VK_NULL_HANDLE; // cluster culling path only
+	VkPipelineLayout clusterCullLayout = VK_NULL_HANDLE; // owned by the pipeline layout cache
+	VkDescriptorSetLayout meshletSetLayout = VK_NULL_HANDLE; // set 0 of whichever pipeline reads the meshlets, owned by the pipeline layout cache
+	VkDescriptorSet meshletSet = VK_NULL_HANDLE; // mesh shader path only, the cluster culling path has one set per frame
+
+	// Must match Instance in instanced.vert and instance_cull.comp
+	struct SceneInstance {
+		glm::mat4 model;
+		glm::vec4 bounds; // world space bounding sphere, xyz center and w radius
+	};
+
+	// Must match the push constant block of instance_cull.comp
+	struct InstanceCullConstants {
+		glm::mat4 viewProjection;
+		uint32_t instanceCount;
+		uint32_t indexCount;
+		uint32_t latePhase; // 0 draws what was visible last frame, 1 tests everything against the depth pyramid
+	};
+
+	// Must match the push constant block of depth_reduce.comp
+	struct DepthReduceConstants {
+		glm::uvec2 sourceSize;
+		glm::uvec2 destinationSize;
+	};
+
+	uint32_t sceneInstanceCount = 0; // 0 draws the single mesh
+	bool requestedGpuDriven = false;
+	bool gpuDriven = false; // chosen for the device when the logical device is created
+	std::vector<SceneInstance> sceneInstances; // kept for the CPU-issued path, which culls them itself
+	float sceneExtent = 0.0f; // width of the instance grid
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	GpuAllocation instanceMemory;
+	VkDescriptorSetLayout instanceSetLayout = VK_NULL_HANDLE; // set 0 of the scene's graphics pipeline, owned by the pipeline layout cache
+	VkDescriptorSet instanceSet = VK_NULL_HANDLE; // the vertex shader's view of the instances
+	const uint32_t viewSet = 2; // set number of the scene's view uniforms, after the bindless table so both modes agree on it
+	VkDescriptorSetLayout viewSetLayout = VK_NULL_HANDLE; // owned by the pipeline layout cache
+	VkDescriptorSet viewUniformSet = VK_NULL_HANDLE; // points at the whole uniform ring, the dynamic offset picks the frame's slice
+	uint32_t viewUniformOffset = 0; // of the frame being recorded
+
+	VkPipeline instanceCullPipeline = VK_NULL_HANDLE; // GPU-driven rendering only
+	VkPipelineLayout instanceCullLayout = VK_NULL_HANDLE; // owned by the pipeline layout cache
+	VkDescriptorSetLayout instanceCullSetLayout = VK_NULL_HANDLE;
+	VkBuffer instanceVisibilityBuffer = VK_NULL_HANDLE; // GPU-driven rendering only -- whether each instance passed the occlusion test last frame
+	GpuAllocation instanceVisibilityMemory;
+
+	// The depth buffer and the occlusion culling pyramid built from it. They follow the swap chain's size and are shared by the frames in flight, which the
+	// graphics queue runs one after the other
+	struct DepthTargets {
+		VkImage image = VK_NULL_HANDLE;
+		GpuAllocation memory;
+		VkImageView view = VK_NULL_HANDLE; // the attachment
+		VkImageView sampledView = VK_NULL_HANDLE; // depth aspect only, read by the pyramid build
+
+		// GPU-driven rendering only. Level 0 is the largest power of two that fits in the depth buffer, each texel holds the farthest depth it covers
+		VkImage pyramid = VK_NULL_HANDLE;
+		GpuAllocation pyramidMemory;
+		VkExtent2D pyramidExtent{};
+		VkImageView pyramidView = VK_NULL_HANDLE; // every level, read by the late culling phase
+		std::vector<VkImageView> pyramidLevelViews; // written one at a time by the build
+		bool pyramidInitialized = false; // moved out of UNDEFINED by the first frame recorded after its creation
+	};
+	DepthTargets depthTargets;
+	VkFormat depthFormat;
+	VkRenderPass earlyRenderPass = VK_NULL_HANDLE; // GPU-driven rendering only -- draws what was visible last frame and keeps the depth for the pyramid
+
+	VkPipeline depthReducePipeline = VK_NULL_HANDLE; // GPU-driven rendering only
+	VkPipelineLayout depthReduceLayout = VK_NULL_HANDLE; // owned by the pipeline layout cache
+	VkDescriptorSetLayout depthReduceSetLayout = VK_NULL_HANDLE;
+	VkSampler depthPyramidSampler = VK_NULL_HANDLE; // nearest, every level. The shaders only use texelFetch
+
+	bool requestedBindless = false;
+	bool bindless = false; // chosen for the device when the logical device is created
+	std::unique_ptr<BindlessTable> bindlessTable;
+	const uint32_t bindlessSet = 1; // set number of the bindless table in every pipeline layout, set 0 stays free for per-pass sets
+
+	VertexFormat vertexFormat;
+	std::string meshPath; // empty for the generated sphere
+	const std::string meshCacheDirectory = "Engine/cache/meshes"; // meshes after the cook step, keyed by source contents
+	GpuMesh mesh;
+	MeshStats meshStats;
+
+	std::unique_ptr<ShaderManager> shaderManager;
+	std::unique_ptr<PipelineLayoutCache> pipelineLayoutCache; // descriptor set and pipeline layouts derived from shader reflection
+	std::unique_ptr<DescriptorAllocator> descriptorAllocator; // every descriptor set outside the bindless table, per frame or cached for the engine's lifetime
+	std::unique_ptr<UniformRing> uniformRing; // per-frame uniform data, bound with dynamic offsets
+
+	const std::string shaderDirectory = "Engine/shaders";
+	std::unique_ptr<ShaderWatcher> shaderWatcher;
+
+	// Shader hot reload and runtime compilation are on by default in debug builds, where shaders are iterated on. Release builds load the offline compiled SPIR-V
+	// Release builds also optimize their shaders and strip the debug info, debug builds keep them as written so debuggers and validation messages can name things
+	#ifdef NDEBUG
+		bool shaderHotReload = false;
+		bool runtimeShaderCompilation = false;
+		ShaderOptimization shaderOptimization = ShaderOptimization::Performance;
+		const bool shaderDebugInfo = false;
+	#else
+		bool shaderHotReload = true;
+		bool runtimeShaderCompilation = true;
+		ShaderOptimization shaderOptimization = ShaderOptimization::None;
+		const bool shaderDebugInfo = true;
+	#endif
+
+	const std::string shaderCacheDirectory = "Engine/cache/shaders"; // compiled GLSL keyed by source, stage and options, and optimized SPIR-V keyed by code and optimizer settings
+	std::vector<ShaderManager::GLSLReload> pendingShaderReloads; // GLSL sources being recompiled in the background after they changed
+	std::vector<VkShaderModule> supersededShaderModules; // replaced by reloads, destroyed once no pipeline compile can still be reading them
+
+	const std::string pipelineCachePath = "Engine/cache/pipeline_cache.bin";
+	std::unique_ptr<PipelineCache> pipelineCache; // persisted between runs so pipelines don't have to be compiled from scratch on every launch
+
+	std::unique_ptr<ThreadPool> threadPool; // background work that must never block the frame loop
+	std::unique_ptr<LatencyMonitor> latencyMonitor;
+	bool displayTiming = false; // VK_GOOGLE_display_timing is enabled, so presents are timed by the driver
+	std::unique_ptr<PipelineCompiler> pipelineCompiler;
+	std::unique_ptr<PipelineRegistry> pipelineRegistry; // deduplicates pipelines with identical state
 
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
+	// Everything the CPU needs to record and submit one frame. Each frame in flight owns its own set so the CPU can record frame N+1 while the GPU is still executing frame N
+	struct FrameData {
+		VkCommandPool commandPool; // one pool per frame so it can be reset in bulk once the frame's fence signals
+		VkCommandBuffer commandBuffer;
+		VkSemaphore imageAvailableSemaphore; // signaled when the acquired swap chain image is ready to be rendered to
+		VkFence inFlightFence; // signaled when the GPU has finished executing this frame's command buffer
+		VkFence presentAcquiredFence = VK_NULL_HANDLE; // signaled when the present queue has executed the ownership acquire, so its command buffer can be freed
+
+		// cluster culling path only -- the compute pass writes the surviving triangles' indices and the indirect draw that renders them
+		VkBuffer culledIndexBuffer = VK_NULL_HANDLE;
+		GpuAllocation culledIndexMemory;
+		VkBuffer drawCommandBuffer = VK_NULL_HANDLE;
+		GpuAllocation drawCommandMemory;
+		VkDescriptorSet clusterCullSet = VK_NULL_HANDLE; // owned by the descriptor allocator
+
+		// GPU-driven rendering only -- the culling pass's compacted draw commands and how many it wrote
+		VkBuffer instanceDrawBuffer = VK_NULL_HANDLE;
+		GpuAllocation instanceDrawMemory;
+		VkBuffer instanceDrawCountBuffer = VK_NULL_HANDLE;
+		GpuAllocation instanceDrawCountMemory;
+
+		// headless mode only -- the frames' staging buffers form a ring the rendered images are copied into, and are read on the CPU once the fence signals
+		VkBuffer readbackBuffer = VK_NULL_HANDLE;
+		GpuAllocation readbackMemory; // persistently mapped
+		bool readbackPending = false; // a copy was recorded that the CPU hasn't consumed yet
+		uint64_t readbackFrameNumber = 0;
+
+		uint64_t latencyTicket = 0; // the latency monitor's wait on inFlightFence, released before the fence is reset
+	};
+
+	uint32_t framesInFlight = 2; // 2 lets the CPU and GPU overlap without adding too much input latency
+	std::vector<FrameData> frames;
+	uint32_t currentFrame = 0;
+	std::vector<VkFence> imagesInFlight; // fence of the frame that last rendered to each swap chain image, the swap chain may hand images back out of order
+
+	FrameStats frameStats;
+	uint64_t completedFrames = 0; // number of frames the GPU is known to have finished, used to decide when retired resources can be destroyed
+
+	bool framebufferResized = false; // set by the GLFW resize callback, some drivers don't report VK_ERROR_OUT_OF_DATE_KHR on resize
+	DeletionQueue deletionQueue; // resources replaced mid-run (old swap chains, image views, framebuffers) wait here until the GPU is done with them
+
+	FramePacer framePacer;
+
 	/*-----------------------------Initialization and Cleanup-----------------------------*/
     void initWindow() {
 		glfwInit();
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 		this->window = glfwCreateWindow(WIDTH, HEIGHT, "Our Engine", nullptr, nullptr);
+		glfwSetWindowUserPointer(window, this); // lets the static callback find the engine instance
+		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	}
+
+	static void framebufferResizeCallback(GLFWwindow* window, int /*width*/, int /*height*/) {
+		auto engine = reinterpret_cast<Engine*>(glfwGetWindowUserPointer(window));
+		engine->framebufferResized = true;
 	}
 
     void initVulkan() {
 		createInstance();
-		createSurface();
+		if (!headless) {
+			createSurface();
+		}
 		pickPhysicalDevice();
 		createLogicalDevice();
-		createSwapChain();
+		latencyMonitor = std::make_unique<LatencyMonitor>(logicalDevice);
+		if (displayTiming) {
+			latencyMonitor->enableDisplayTiming();
+		}
+		gpuAllocator = std::make_unique<GpuAllocator>(logicalDevice, physicalDevice);
+		uploadManager = std::make_unique<UploadManager>(logicalDevice, *gpuAllocator, queueTopology.transfer.family, transferQueue, queueTopology.graphics.family);
+		pipelineCache = std::make_unique<PipelineCache>(logicalDevice, physicalDevice, pipelineCachePath);
+		threadPool = std::make_unique<ThreadPool>(std::max(2u, std::thread::hardware_concurrency()) - 1); // leave a core for the main thread. hardware_concurrency may return 0 when it can't tell
+		pipelineCompiler = std::make_unique<PipelineCompiler>(logicalDevice, *pipelineCache, *threadPool);
+		pipelineRegistry = std::make_unique<PipelineRegistry>(*pipelineCompiler);
+		shaderManager = std::make_unique<ShaderManager>(logicalDevice);
+		pipelineLayoutCache = std::make_unique<PipelineLayoutCache>(logicalDevice);
+		descriptorAllocator = std::make_unique<DescriptorAllocator>(logicalDevice, framesInFlight);
+		uniformRing = std::make_unique<UniformRing>(logicalDevice, *gpuAllocator, physicalDevice, 64 * 1024, framesInFlight);
+		if (bindless) {
+			bindlessTable = std::make_unique<BindlessTable>(logicalDevice, physicalDevice, 4096, 4096);
+			pipelineLayoutCache->reserveSet(bindlessSet, bindlessTable->getSetLayout(), BindlessTable::bindingTypes());
+		}
+		if (sceneInstanceCount > 0) { // the view uniforms are a slice of the uniform ring, picked with a dynamic offset that reflection can't know about
+			VkDescriptorSetLayoutBinding viewBinding{ 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+			viewSetLayout = pipelineLayoutCache->getSetLayout({ viewBinding });
+			pipelineLayoutCache->reserveSet(viewSet, viewSetLayout, { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC });
+		}
+		// the build runs compile_shaders before compiling the engine, so missing SPIR-V means the build step failed or was skipped
+		if (!runtimeShaderCompilation && !hasPrecompiledShaders(geometryPath)) {
+			throw std::runtime_error("precompiled shaders are missing, run Engine/shaders/compile_shaders!");
+		}
+		if (runtimeShaderCompilation) {
+			shaderManager->enableRuntimeCompilation(*threadPool, shaderCacheDirectory);
+		}
+		ShaderOptimizerSettings optimizerSettings{ shaderOptimization, !shaderDebugInfo, VK_API_VERSION_1_0 };
+		if (optimizerSettings.isEnabled() && ShaderOptimizer::isAvailable()) {
+			shaderManager->enableOptimization(optimizerSettings, shaderCacheDirectory);
+		}
+		else if (optimizerSettings.isEnabled()) {
+			std::cout << "spirv-tools optimizer isn't linked, precompiled shaders are used as compiled (compile_shaders optimizes them)" << std::endl;
+		}
+		if (headless) {
+			createOffscreenTargets();
+		}
+		else {
+			createSwapChain();
+			createImageSemaphores();
+			createPresentAcquireCommands();
+		}
 		createImageViews();
-		createRenderPass();
+		depthFormat = findDepthFormat();
+		renderPass = createRenderPass(!gpuDriven, true); // with occlusion culling it continues what the early pass drew
+		if (gpuDriven) {
+			earlyRenderPass = createRenderPass(true, false);
+		}
 		createGraphicsPipeline();
+		if (geometryPath == GeometryPath::ClusterCulling) {
+			createClusterCullPipeline();
+		}
+		if (gpuDriven) {
+			createInstanceCullPipeline();
+			createDepthReducePipeline();
+		}
+		createDepthTargets();
 		createFramebuffers();
+		createFrameResources();
+		createMesh();
+
+		if (shaderHotReload && !headless) {
+			shaderWatcher = std::make_unique<ShaderWatcher>(shaderDirectory);
+		}
 	}
 
     void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-			glfwPollEvents();
+		if (headless) {
+			while (frameStats.framesSubmitted < headlessFrameCount) {
+				drawFrame();
+			}
+		}
+		else {
+			while (!glfwWindowShouldClose(window)) {
+				glfwPollEvents();
+				drawFrame();
+			}
 		}
+
+		vkDeviceWaitIdle(logicalDevice); // wait for the last frames to finish before anything gets destroyed
+
+		// the last frames' readbacks are only delivered when their slot comes around again, which won't happen anymore
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			deliverReadback(frames[(currentFrame + i) % framesInFlight]);
+		}
+
+		memoryStats = gpuAllocator->getHeapStats();
+		uploadStats = { uploadManager->getBytesUploaded(), uploadManager->getBatchesSubmitted(), uploadManager->getRingStalls(), uploadManager->usesDedicatedQueue() };
 	}
 
     void cleanup() {
 
+		shaderWatcher.reset(); // stops the watch thread
+		latencyMonitor->waitIdle(); // done with the fences before they are destroyed. It stays alive for its stats
+
+		deletionQueue.flush(); // the device is idle, so anything still waiting on in-flight frames can go
+
+		for (auto& frame : frames) {
+			vkDestroySemaphore(logicalDevice, frame.imageAvailableSemaphore, nullptr);
+			if (frame.presentAcquiredFence != VK_NULL_HANDLE) {
+				vkDestroyFence(logicalDevice, frame.presentAcquiredFence, nullptr);
+			}
+			vkDestroyFence(logicalDevice, frame.inFlightFence, nullptr);
+			vkDestroyCommandPool(logicalDevice, frame.commandPool, nullptr); // also frees the command buffer allocated from it
+
+			if (frame.readbackBuffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(logicalDevice, frame.readbackBuffer, nullptr);
+				gpuAllocator->free(frame.readbackMemory);
+			}
+
+			destroyGpuBuffer(frame.culledIndexBuffer, frame.culledIndexMemory);
+			destroyGpuBuffer(frame.drawCommandBuffer, frame.drawCommandMemory);
+			destroyGpuBuffer(frame.instanceDrawBuffer, frame.instanceDrawMemory);
+			destroyGpuBuffer(frame.instanceDrawCountBuffer, frame.instanceDrawCountMemory);
+		}
+
 		for (auto framebuffer : swapChainFramebuffers) {
 			vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
 		}
+		destroyDepthTargets(depthTargets);
+		if (depthPyramidSampler != VK_NULL_HANDLE) {
+			vkDestroySampler(logicalDevice, depthPyramidSampler, nullptr);
+		}
+
+		destroyGpuBuffer(mesh.vertexBuffer, mesh.vertexMemory);
+		destroyGpuBuffer(mesh.indexBuffer, mesh.indexMemory);
+		destroyGpuBuffer(mesh.meshletBuffer, mesh.meshletMemory);
+		destroyGpuBuffer(mesh.meshletBoundsBuffer, mesh.meshletBoundsMemory);
+		destroyGpuBuffer(mesh.meshletVertexBuffer, mesh.meshletVertexMemory);
+		destroyGpuBuffer(mesh.meshletTriangleBuffer, mesh.meshletTriangleMemory);
+		destroyGpuBuffer(instanceBuffer, instanceMemory);
+		destroyGpuBuffer(instanceVisibilityBuffer, instanceVisibilityMemory);
+		uniformRing->destroy();
+
+		uploadManager->destroy();
+
+		if (presentCommandPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(logicalDevice, presentCommandPool, nullptr); // also frees the acquire command buffers
+		}
+
+		pipelineCompiler->destroy(); // waits for compiles that are still running
+		if (clusterCullPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(logicalDevice, clusterCullPipeline, nullptr);
+		}
+		if (instanceCullPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(logicalDevice, instanceCullPipeline, nullptr);
+		}
+		if (depthReducePipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(logicalDevice, depthReducePipeline, nullptr);
+		}
+		pendingShaderReloads.clear();
+		threadPool.reset(); // joins the workers
+		for (VkShaderModule oldModule : supersededShaderModules) {
+			vkDestroyShaderModule(logicalDevice, oldModule, nullptr);
+		}
 
-		vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+		shaderManager->destroy();
 
-		vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+		pipelineCache->save();
+		pipelineCache->destroy();
+
+		descriptorAllocator->destroy();
+		pipelineLayoutCache->destroy();
+		if (bindlessTable) {
+			bindlessTable->destroy();
+		}
 
 		vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
+		if (earlyRenderPass != VK_NULL_HANDLE) {
+			vkDestroyRenderPass(logicalDevice, earlyRenderPass, nullptr);
+		}
 
 		for (auto imageView : swapChainImageViews) {
 			vkDestroyImageView(logicalDevice, imageView, nullptr);
 		}
 
-		vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+		if (headless) {
+			for (size_t i = 0; i < swapChainImages.size(); i++) {
+				vkDestroyImage(logicalDevice, swapChainImages[i], nullptr);
+				gpuAllocator->free(offscreenImageMemory[i]);
+			}
+		}
+		else {
+			destroyImageSemaphores(logicalDevice, renderFinishedSemaphores, presentAcquiredSemaphores);
+			vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+		}
+
+		gpuAllocator->destroy();
 
 		vkDestroyDevice(logicalDevice, nullptr);
 
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		if (!headless) {
+			vkDestroySurfaceKHR(instance, surface, nullptr);
+		}
 
 		vkDestroyInstance(instance, nullptr);
 
-		glfwDestroyWindow(window);
+		if (!headless) {
+			glfwDestroyWindow(window);
 
-		glfwTerminate();
+			glfwTerminate();
+		}
 	}
 	/*---------------------------------------------------------------------------------*/
 
@@ -156,7 +793,7 @@ private:
 		VkPhysicalDeviceFeatures deviceFeatures;
 		vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
-		QueueFamilyIndices indices = findQueueFamilies(device);
+		QueueTopology topology = findQueueFamilies(device);
 
 		int score = 0;
 
@@ -170,35 +807,147 @@ private:
 
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-		bool adequateSwapChain = false;
-		if (extensionsSupported) {
+		bool adequateSwapChain = headless; // nothing is presented in headless mode
+		if (extensionsSupported && !headless) {
 			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			adequateSwapChain = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
 
 		// Application can't function without geometry shaders, available queues, and required extensions
-		if (!deviceFeatures.geometryShader || !indices.isComplete() || !adequateSwapChain) {
+		if (!deviceFeatures.geometryShader || !topology.isComplete() || !adequateSwapChain) {
 			return 0;
 		}
 
+		// Mesh shaders cull and draw meshlets without the compute pass and the indirect draw in between
+		if (checkMeshShaderSupport(device)) {
+			score += 500;
+		}
+
 		return score;
 	}
 
 	// Check if the GPU supports the required extensions
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+		std::set<std::string> availableExtensions = getDeviceExtensions(device);
+
+		for (const char* extension : getRequiredDeviceExtensions()) {
+			if (availableExtensions.count(extension) == 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Names of every extension the GPU supports
+	std::set<std::string> getDeviceExtensions(VkPhysicalDevice device) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
 		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
+		std::set<std::string> names;
 		for (const auto& extension : availableExtensions) {
-			requiredExtensions.erase(extension.extensionName);
+			names.insert(extension.extensionName);
+		}
+		return names;
+	}
+
+	// Check if the GPU can take the mesh shader path: VK_EXT_mesh_shader with both task and mesh shaders, and Vulkan 1.2 for the SPIR-V 1.4 they are compiled to
+	bool checkMeshShaderSupport(VkPhysicalDevice device) {
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+		if (instanceApiVersion < VK_API_VERSION_1_2 || deviceProperties.apiVersion < VK_API_VERSION_1_2 || getDeviceExtensions(device).count(VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0) {
+			return false;
+		}
+
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+		meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures{};
+		deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures.pNext = &meshShaderFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+		return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+	}
+
+	// Check if the GPU can take GPU-driven rendering: vkCmdDrawIndexedIndirectCount from Vulkan 1.2, and indirect draws with a first instance, which is how
+	// the culling pass tells the vertex shader which instance a draw is for
+	bool checkDrawIndirectCountSupport(VkPhysicalDevice device) {
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+		if (instanceApiVersion < VK_API_VERSION_1_2 || deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+			return false;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures{};
+		deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures.pNext = &vulkan12Features;
+		vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+		return vulkan12Features.drawIndirectCount && deviceFeatures.features.drawIndirectFirstInstance;
+	}
+
+	// The SPIR-V produced by compile_shaders that a geometry path loads
+	std::vector<std::string> precompiledShaders(GeometryPath path) const {
+		std::vector<std::string> shaders = { "/frag.spv" };
+		if (path == GeometryPath::MeshShader) {
+			shaders.insert(shaders.end(), { "/meshlet_task.spv", "/meshlet_mesh.spv" });
+		}
+		else {
+			shaders.push_back(sceneInstanceCount == 0 ? "/vert.spv" : bindless ? "/instanced_bindless_vert.spv" : "/instanced_vert.spv");
+		}
+		if (path == GeometryPath::ClusterCulling) {
+			shaders.push_back("/meshlet_cull.spv");
+		}
+		if (gpuDriven) {
+			shaders.insert(shaders.end(), { "/instance_cull.spv", "/depth_reduce.spv" });
+		}
+		return shaders;
+	}
+
+	// Whether compile_shaders has produced the SPIR-V the geometry path loads
+	bool hasPrecompiledShaders(GeometryPath path) const {
+		std::vector<std::string> shaders = precompiledShaders(path);
+		return std::all_of(shaders.begin(), shaders.end(), [this](const std::string& shader) { return std::filesystem::exists(shaderDirectory + shader); });
+	}
+
+	// Pick the geometry path for the chosen GPU. Meshlets are culled on every device, by mesh shaders where they are supported and by a compute pass otherwise
+	void chooseGeometryPath() {
+		bool meshShaderSupported = checkMeshShaderSupport(physicalDevice);
+
+		geometryPath = requestedGeometryPath;
+		if (geometryPath == GeometryPath::Automatic || (geometryPath == GeometryPath::MeshShader && !meshShaderSupported)) {
+			geometryPath = meshShaderSupported ? GeometryPath::MeshShader : GeometryPath::ClusterCulling;
+		}
+
+		// scenes are culled per instance instead of per meshlet, and drawn with the instanced vertex shader
+		if (sceneInstanceCount > 0) {
+			if (requestedGeometryPath != GeometryPath::Automatic && requestedGeometryPath != GeometryPath::Indexed) {
+				std::cout << "scenes are drawn with the indexed geometry path, the requested geometry path is ignored" << std::endl;
+			}
+			geometryPath = GeometryPath::Indexed;
 		}
+		gpuDriven = requestedGpuDriven && sceneInstanceCount > 0 && checkDrawIndirectCountSupport(physicalDevice);
 
-		return requiredExtensions.empty();
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		bool vulkan12 = instanceApiVersion >= VK_API_VERSION_1_2 && deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+		bindless = requestedBindless && sceneInstanceCount > 0 && vulkan12 && BindlessTable::isSupported(physicalDevice);
+	}
+
+	// The device extensions the engine needs in the current mode. Headless mode doesn't present, so it doesn't need the swap chain extension
+	std::vector<const char*> getRequiredDeviceExtensions() {
+		if (headless) {
+			return {};
+		}
+		return deviceExtensions;
 	}
 
 	/*---------------------------------------------------------------------------------*/
@@ -217,16 +966,25 @@ private:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		// Vulkan 1.2 where the loader has it, the mesh shader path needs it. Each device is still checked for the version it supports
+		auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+		if (enumerateInstanceVersion != nullptr) { // a 1.0 loader doesn't have it
+			uint32_t loaderVersion = VK_API_VERSION_1_0;
+			enumerateInstanceVersion(&loaderVersion);
+			instanceApiVersion = std::min(loaderVersion, static_cast<uint32_t>(VK_API_VERSION_1_2));
+		}
+		appInfo.apiVersion = instanceApiVersion;
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		createInfo.pApplicationInfo = &appInfo;
 
 		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
+		const char** glfwExtensions = nullptr;
 
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		if (!headless) { // without a surface no window system extensions are needed
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		}
 
 		createInfo.enabledExtensionCount = glfwExtensionCount;
 
@@ -281,22 +1039,11 @@ private:
 
 	// Create the logical device that interfaces with the physical device -- this creates the queues that will be used to interface with the physical device
 	void createLogicalDevice() {
-		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-
-		// Continue here at "Creating the presentation queue" in the Window Surface section of the tutorial
-
-		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		queueTopology = findQueueFamilies(physicalDevice);
+		chooseGeometryPath();
 
-		float queuePriority = 1.0f; // assignable priority of this queue, 0.0f to 1.0f, that influences the scheduling of command buffer execution (within the family?). Required even if there is only one queue
-		for (uint32_t queueFamily : uniqueQueueFamilies) {
-			VkDeviceQueueCreateInfo queueCreateInfo{};
-			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-			queueCreateInfo.queueFamilyIndex = queueFamily;
-			queueCreateInfo.queueCount = 1; // apparently current drivers only support a few queues per family, but "you don't really need more than one", I guess I'll see for myself
-			queueCreateInfo.pQueuePriorities = &queuePriority;
-			queueCreateInfos.push_back(queueCreateInfo);
-		}
+		// one create info per family, with as many queues as the topology asked for and their priorities
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = queueTopology.queueCreateInfos();
 		
 		/*
 		* Old code for creating a single queue, now we create a queue for each family that we need
@@ -310,14 +1057,45 @@ private:
 		*/
 		
 		VkPhysicalDeviceFeatures deviceFeatures{}; // Used to enable or disable available features on chosen physical device
+		deviceFeatures.drawIndirectFirstInstance = gpuDriven ? VK_TRUE : VK_FALSE;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pEnabledFeatures = &deviceFeatures; // setting our enabled features
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data(); // setting the device specific extensions
+		std::vector<const char*> extensions = getRequiredDeviceExtensions();
+
+		// display timing reports presentation times on CLOCK_MONOTONIC, the steady clock's domain on Linux. Elsewhere the clocks can't be compared
+#ifdef PLATFORM_LINUX
+		displayTiming = !headless && getDeviceExtensions(physicalDevice).count(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) != 0;
+		if (displayTiming) {
+			extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+		}
+#endif
+
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+		meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		if (geometryPath == GeometryPath::MeshShader) {
+			extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+			meshShaderFeatures.taskShader = VK_TRUE;
+			meshShaderFeatures.meshShader = VK_TRUE;
+			createInfo.pNext = &meshShaderFeatures;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.drawIndirectCount = gpuDriven ? VK_TRUE : VK_FALSE;
+		if (bindless) {
+			BindlessTable::enableFeatures(vulkan12Features);
+		}
+		if (gpuDriven || bindless) {
+			vulkan12Features.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &vulkan12Features;
+		}
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data(); // setting the device specific extensions
 
 		// Validation layers -- used for debugging
 		if (enableValidationLayers) {
@@ -333,193 +1111,152 @@ private:
 			throw std::runtime_error("failed to create logical device!");
 		}
 
-		// until I optimize the findQueueFamilies function to choose different and independent queues for different operations, graphicsQueue and presentQueue will hold the same value (point to the same queue)
-		vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue); // assign the graphics queue that was created with the logical device (will likely move this later on)
-		vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0, &presentQueue); // assign the present queue that was created with the logical device (will likely move this later on)
+		// roles that share a queue get the same handle. All submits happen on the main thread, so shared queues need no extra locking
+		DeviceQueues queues = DeviceQueues::get(logicalDevice, queueTopology);
+		graphicsQueue = queues.graphics;
+		presentQueue = queues.present;
+		computeQueue = queues.compute;
+		transferQueue = queues.transfer;
+
+		if (geometryPath == GeometryPath::MeshShader) {
+			vkCmdDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(logicalDevice, "vkCmdDrawMeshTasksEXT"));
+			if (vkCmdDrawMeshTasks == nullptr) {
+				throw std::runtime_error("failed to load vkCmdDrawMeshTasksEXT!");
+			}
+		}
 	}
 
 	// Create the basic graphics pipeline that will be used to render the 2d images -- a different pipeline has to be created for any different rendering style so I'll likely have to create a new one for 3d rendering and more
+	// The optimized pipeline is compiled in the background. Until it is done, frames are drawn with a fallback the compiler builds on the pool from each variant's own state
+	// with driver optimizations disabled, which compiles much faster. The first frame waits for that fallback if it isn't done yet
 	void createGraphicsPipeline() {
-		ShaderManager shaderManager(logicalDevice);
-
-		auto vertShaderCode = shaderManager.readFile("Engine/shaders/vert.spv");
-		auto fragShaderCode = shaderManager.readFile("Engine/shaders/frag.spv");
+		// the mesh shader path replaces the vertex shader with a task and a mesh shader, the fragment shader is shared
+		bool meshShading = geometryPath == GeometryPath::MeshShader;
+		bool drawsScene = sceneInstanceCount > 0; // the instanced vertex shader takes each instance's transform from a storage buffer
+
+		// the shader manager owns the modules, so they outlive the background compile and are shared with any other pipeline using the same shaders
+		std::vector<VkShaderModule> modules;
+		if (shaderManager->canCompileGLSL()) {
+			ShaderCompileOptions options{};
+			options.optimization = shaderOptimization;
+			options.debugInfo = shaderDebugInfo;
+			ShaderCompileOptions meshOptions = options;
+			meshOptions.targetVulkanVersion = VK_API_VERSION_1_2; // SPV_EXT_mesh_shader needs SPIR-V 1.4
+			if (meshShading) {
+				modules = shaderManager->loadGLSLModules({ { shaderDirectory + "/meshlet.task", meshOptions }, { shaderDirectory + "/meshlet.mesh", meshOptions }, { shaderDirectory + "/shader.frag", options } }); // compiled in parallel
+			}
+			else {
+				ShaderCompileOptions vertexOptions = options;
+				if (bindless) {
+					vertexOptions.defines.push_back({ "BINDLESS", "" });
+				}
+				modules = shaderManager->loadGLSLModules({ { shaderDirectory + (drawsScene ? "/instanced.vert" : "/shader.vert"), vertexOptions }, { shaderDirectory + "/shader.frag", options } });
+			}
+		}
+		else if (meshShading) {
+			modules = { shaderManager->loadShaderModule(shaderDirectory + "/meshlet_task.spv"), shaderManager->loadShaderModule(shaderDirectory + "/meshlet_mesh.spv"), shaderManager->loadShaderModule(shaderDirectory + "/frag.spv") };
+		}
+		else {
+			std::string vertexShader = !drawsScene ? "/vert.spv" : bindless ? "/instanced_bindless_vert.spv" : "/instanced_vert.spv";
+			modules = { shaderManager->loadShaderModule(shaderDirectory + vertexShader), shaderManager->loadShaderModule(shaderDirectory + "/frag.spv") };
+		}
 
-		VkShaderModule vertShaderModule = shaderManager.createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = shaderManager.createShaderModule(fragShaderCode);
+		// the descriptor set layouts and push constant ranges come from the shaders themselves, and are shared with every pipeline whose shaders declare the same interface
+		std::vector<const ShaderReflection*> reflections;
+		for (VkShaderModule module : modules) {
+			reflections.push_back(&shaderManager->getReflection(module));
+		}
+		ReflectedLayout layout = pipelineLayoutCache->buildLayout(reflections);
+		pipelineLayout = layout.pipelineLayout;
+		pushConstantStages = layout.pushConstantRanges.empty() ? 0 : layout.pushConstantRanges[0].stageFlags;
+
+		GraphicsPipelineDesc desc{};
+		for (size_t i = 0; i < modules.size(); i++) {
+			GraphicsPipelineDesc::ShaderStage stage;
+			stage.stage = reflections[i]->stage;
+			stage.module = modules[i];
+			desc.stages.push_back(stage);
+		}
 
-		// vertex shader stage info
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; // struct type
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT; // shader stage
-		vertShaderStageInfo.module = vertShaderModule; // shader module
-		vertShaderStageInfo.pName = "main"; // entry point - main function
+		if (meshShading) {
+			meshletSetLayout = layout.setLayouts[0];
+
+			// the mesh shader fetches and decodes the vertices itself, so it is told how they are encoded and where each attribute lives, in words
+			GraphicsPipelineDesc::ShaderStage& meshStage = desc.stages[1];
+			meshStage.setSpecializationConstant(2, static_cast<uint32_t>(vertexFormat.position)); // POSITION_ENCODING
+			meshStage.setSpecializationConstant(3, static_cast<uint32_t>(vertexFormat.direction)); // DIRECTION_ENCODING
+			meshStage.setSpecializationConstant(4, static_cast<uint32_t>(vertexFormat.texCoord)); // TEXCOORD_ENCODING
+			meshStage.setSpecializationConstant(5, static_cast<uint32_t>(vertexFormat.color)); // COLOR_ENCODING
+			for (const auto& attribute : vertexFormat.attributes()) {
+				if (attribute.attribute == VertexAttribute::Normal) meshStage.setSpecializationConstant(6, attribute.offset / 4); // NORMAL_OFFSET
+				else if (attribute.attribute == VertexAttribute::TexCoord) meshStage.setSpecializationConstant(7, attribute.offset / 4); // TEXCOORD_OFFSET
+				else if (attribute.attribute == VertexAttribute::Color) meshStage.setSpecializationConstant(8, attribute.offset / 4); // COLOR_OFFSET
+			}
+			meshStage.setSpecializationConstant(9, vertexFormat.stride() / 4); // VERTEX_STRIDE
+		}
+		else {
+			if (drawsScene && !bindless) {
+				instanceSetLayout = layout.setLayouts[0];
+			}
 
-		// fragment shader stage info
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
+			// the shader declares which attributes it reads, the vertex format decides how they are stored
+			vertexFormat.describe(*reflections[0], desc.vertexBindings, desc.vertexAttributes);
+			if (reflections[0]->hasSpecializationConstant(1)) {
+				desc.stages[0].setSpecializationConstant(1, vertexFormat.octahedralDirections() ? VK_TRUE : VK_FALSE); // OCTAHEDRAL_DIRECTIONS
+			}
+		}
+		desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		desc.cullMode = VK_CULL_MODE_BACK_BIT; // cull the back faces of the geometry
+		desc.frontFace = MeshData::frontFace;
+		desc.depthTest = true;
+		desc.depthWrite = true;
+		desc.depthCompareOp = VK_COMPARE_OP_LESS; // depth runs from 0 at the near plane to 1 at the far plane
+		desc.colorBlendAttachments = { GraphicsPipelineDesc::alphaBlendAttachment() }; // per framebuffer configuration -- currently we only have one. TODO: implement for multiple framebuffers
+		desc.layout = pipelineLayout;
+		desc.renderPass = renderPass;
+		desc.subpass = 0;
+		desc.colorFormats = { swapChainImageFormat };
+		desc.depthFormat = depthFormat;
+
+		// the features the triangle's material can toggle, each one a specialization constant in its shaders
+		trianglePermutations = std::make_unique<ShaderPermutationSet>(*pipelineRegistry, *shaderManager, desc, std::vector<ShaderPermutationSet::Feature>{ { "GRAYSCALE", 0 } });
+		trianglePipeline = trianglePermutations->getVariant(triangleFeatures);
+	}
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo }; // define the shaders stages in our pipeline
+	// Create a render pass that renders to the swap chain images and the depth buffer. A frame is either a single pass that clears and finishes the image,
+	// or with occlusion culling an early pass that clears and keeps its depth for the pyramid, followed by a late pass that loads what it drew and finishes.
+	// Load/store ops and layouts don't affect compatibility, so pipelines and framebuffers work with either
+	VkRenderPass createRenderPass(bool clears, bool finishesFrame) {
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = swapChainImageFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; // only one sample per pixel since we are not yet using multisampling
+		
+		// These two fields specify what to do with the data in the attachment before rendering (loadOp) and after rendering (storeOp)
+		colorAttachment.loadOp = clears ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 
-		std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-		};
+		// These two fields specify what to do with the stencil data in the attachment before rendering (loadOp) and after rendering (storeOp)
+		// We don't use the stencil buffer yet, so we don't care about these values. TODO: Implement stencil buffer for use with shadows and reflections (and possibly more)
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-		dynamicState.pDynamicStates = dynamicStates.data();
+		// The initialLayout specifies which layout the image will have before the render pass begins. finalLayout specifies the layout to automatically transition to when the render pass finishes
+		colorAttachment.initialLayout = clears ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // let the initial layout be anything, unless the early pass's contents are kept
+		colorAttachment.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // let the final layout be ready for presentation, or for the copy back to host memory in headless mode
+		if (!finishesFrame) {
+			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
 
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 0;
-		vertexInputInfo.pVertexBindingDescriptions = nullptr; // will point to an array of structs that describe the format of the vertex data. Todo: implement
-		vertexInputInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr; // will point to an array of structs that describe the attributes passed to the vertex shader. Todo: implement
-
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // primitive topology - how the vertices are used to form primitives/geometries
-		inputAssembly.primitiveRestartEnable = VK_FALSE; // periodically restart the drawing of primitives from the beginning of the current draw call
-
-		VkViewport viewport{}; // viewport - region of the framebuffer that the output will be rendered to
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor{}; // scissor window - pixels outside the scissor window are discarded by the rasterizer
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer{}; // rasterizer - turns the geometry from the vertex shader into fragments, also performs depth testing, face culling and the scissor window. TODO: implement
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE; // if true, fragments that are beyond the near and far planes are clamped to them as opposed to discarding them (useful for shadow maps)
-		rasterizer.rasterizerDiscardEnable = VK_FALSE; // if true, geometry never passes through the rasterizer stage and nothing is drawn to the framebuffer
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // fill the polygons with fragments to be colored. Other modes include line and point (think wireframe)
-		rasterizer.lineWidth = 1.0f; // line width in terms of number of fragments -- maximum linewidth is hardware dependent and >1f requires enabling a GPU feature
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // cull the back faces of the geometry
-		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; // front face of the geometry is the one that is clockwise
-
-		// depth bias - adds a constant value or a value proportional to the fragment's slope to the depth of the fragment (useful for shadow mapping). TODO: implement
-		rasterizer.depthBiasEnable = VK_FALSE;
-		rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-		rasterizer.depthBiasClamp = 0.0f; // Optional
-		rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-		// multisampling - efficient anti-aliasing technique. TODO: implement
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		multisampling.minSampleShading = 1.0f; // Optional
-		multisampling.pSampleMask = nullptr; // Optional 
-		multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-		multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-		// depth and stencil testing - compare the depth of the new fragment with the depth buffer to see if it should be discarded. TODO: implement
-		VkPipelineDepthStencilStateCreateInfo depthStencil{};
-
-		// color blending - combine the color of what is already in the framebuffer with the color of the new fragment being written
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{}; // per framebuffer configuration -- currently we only have one. TODO: implement for multiple framebuffers
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-		VkPipelineColorBlendStateCreateInfo colorBlending{}; // global color blending configuration
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f; // Optional
-		colorBlending.blendConstants[1] = 0.0f; // Optional
-		colorBlending.blendConstants[2] = 0.0f; // Optional
-		colorBlending.blendConstants[3] = 0.0f; // Optional
-
-		// define the uniform values that will be used in the shaders
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0; // Optional
-		pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-		pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-		if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
-
-		// create graphics pipeline with everything we've set up for it
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-
-		// fixed-function stage
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = nullptr; // Optional
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = &dynamicState;
-
-		// pipeline layout
-		pipelineInfo.layout = pipelineLayout;
-
-		// render pass
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0; // index of th sub pass where the graphics pipeline will be used
-
-		// These parameters are used to create a new pipeline by deriving from an existing pipeline. Only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is set in the flags field of the VkGraphicsPipelineCreateInfo struct
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional - a pipeline to derive from
-		pipelineInfo.basePipelineIndex = -1; // Optional - an index to derive from
-
-		if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!");
-		}
-
-		vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
-		vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
-	}
-
-	// Create the render pass that will be used to render the images to the swap chain
-	void createRenderPass() {
-		VkAttachmentDescription colorAttachment{};
-		colorAttachment.format = swapChainImageFormat;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; // only one sample per pixel since we are not yet using multisampling
-		
-		// These two fields specify what to do with the data in the attachment before rendering (loadOp) and after rendering (storeOp)
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-		// These two fields specify what to do with the stencil data in the attachment before rendering (loadOp) and after rendering (storeOp)
-		// We don't use the stencil buffer yet, so we don't care about these values. TODO: Implement stencil buffer for use with shadows and reflections (and possibly more)
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-
-		// The initialLayout specifies which layout the image will have before the render pass begins. finalLayout specifies the layout to automatically transition to when the render pass finishes
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // let the initial layout be anything
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // let the final layout be ready for presentation
+		// The depth buffer is only kept past the render pass for the pyramid build, which samples it in the read-only layout
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = clears ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.storeOp = finishesFrame ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = clears ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthAttachment.finalLayout = finishesFrame ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentRef{};
 		colorAttachmentRef.attachment = 0; // index of the attachment in the attachment descriptions array. Since we only have one attachment, it is 0
@@ -528,19 +1265,58 @@ private:
 		VkSubpassDescription subpass{}; // a single render pass can consist of multiple subpasses. Subpasses are subsequent rendering operations that depend on the contents of framebuffers in previous passes
 		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // graphics subpass as apposed to a compute subpass. Graphics subpasses are used for drawing operations. Compute subpasses are used for compute operations. TODO: Implement compute subpasses for audio raytracing?
 
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 		subpass.colorAttachmentCount = 1;
 		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// The image is acquired asynchronously, so the layout transition at the start of the render pass has to wait until the acquire semaphore is signaled at the color attachment output stage.
+		// The depth buffer is shared by the frames in flight, so the last frame's depth writes and pyramid build have to be done with it before it is cleared, and a late pass
+		// has to wait for the early pass's color and depth
+		VkSubpassDependency dependencies[2]{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL; // the implicit subpass before the render pass
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// an early pass hands its depth to the pyramid build, and in headless mode the last pass hands the image to the readback copy. The implicit
+		// dependency at the end of a render pass has no destination access, so without it the copy could read the image before the color writes land
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		if (!finishesFrame) {
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+		else {
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		}
+
+		VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
 
 		VkRenderPassCreateInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
+		renderPassInfo.attachmentCount = 2;
+		renderPassInfo.pAttachments = attachments;
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = finishesFrame && !headless ? 1 : 2; // presenting is ordered by the semaphores instead
+		renderPassInfo.pDependencies = dependencies;
 
-		if (vkCreateRenderPass(logicalDevice, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		VkRenderPass pass;
+		if (vkCreateRenderPass(logicalDevice, &renderPassInfo, nullptr, &pass) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create render pass!");
 		}
+		return pass;
 	}
 
 	// Create the framebuffers that will be used modify the images in the swap chain. You need one framebuffer for each image in the swap chain
@@ -550,13 +1326,14 @@ private:
 		// Create a framebuffer for each image view
 		for (size_t i = 0; i < swapChainImageViews.size(); i++) {
 			VkImageView attachments[] = {
-				swapChainImageViews[i]
+				swapChainImageViews[i],
+				depthTargets.view // shared by every framebuffer, frames don't overlap on the GPU
 			};
 
 			VkFramebufferCreateInfo framebufferInfo{};
 			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.attachmentCount = 1;
+			framebufferInfo.attachmentCount = 2;
 			framebufferInfo.pAttachments = attachments;
 			framebufferInfo.width = swapChainExtent.width;
 			framebufferInfo.height = swapChainExtent.height;
@@ -567,58 +1344,1140 @@ private:
 			}
 		}
 	}
+	/*--------------------------------------Depth--------------------------------------*/
+	// The first depth format the device can render to, and sample from when occlusion culling builds the depth pyramid from it
+	VkFormat findDepthFormat() {
+		VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | (gpuDriven ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0);
+		for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }) {
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+			if ((properties.optimalTilingFeatures & features) == features) {
+				return format;
+			}
+		}
+
+		throw std::runtime_error("failed to find a supported depth format!");
+	}
+
+	// Create a 2D image and its memory, with a single layer and sample
+	void createGpuImage(VkFormat format, VkExtent2D extent, uint32_t mipLevels, VkImageUsageFlags usage, VkImage& image, GpuAllocation& memory) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+
+		memory = gpuAllocator->allocateImage(image, MemoryUsage::GpuOnly);
+	}
+
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t baseMipLevel, uint32_t mipLevels) {
+		VkImageViewCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image = image;
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format = format;
+		createInfo.subresourceRange.aspectMask = aspect;
+		createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+		createInfo.subresourceRange.levelCount = mipLevels;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+
+		VkImageView view;
+		if (vkCreateImageView(logicalDevice, &createInfo, nullptr, &view) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image views!");
+		}
+		return view;
+	}
+
+	// Create the depth buffer at the swap chain's size, and with GPU-driven rendering the depth pyramid
+	void createDepthTargets() {
+		bool hasStencil = depthFormat != VK_FORMAT_D32_SFLOAT;
+		createGpuImage(depthFormat, swapChainExtent, 1, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (gpuDriven ? VK_IMAGE_USAGE_SAMPLED_BIT : 0), depthTargets.image, depthTargets.memory);
+		depthTargets.view = createImageView(depthTargets.image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0), 0, 1);
+
+		if (!gpuDriven) {
+			return;
+		}
+
+		depthTargets.sampledView = createImageView(depthTargets.image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1); // only one aspect can be sampled
+
+		// a power of two keeps every level exactly half the one below, so only level 0 has uneven footprints
+		auto previousPowerOfTwo = [](uint32_t value) {
+			uint32_t result = 1;
+			while (result * 2 <= value) {
+				result *= 2;
+			}
+			return result;
+		};
+		depthTargets.pyramidExtent = { previousPowerOfTwo(swapChainExtent.width), previousPowerOfTwo(swapChainExtent.height) };
+		uint32_t levelCount = 1;
+		while ((std::max(depthTargets.pyramidExtent.width, depthTargets.pyramidExtent.height) >> levelCount) > 0) {
+			levelCount++;
+		}
+
+		createGpuImage(VK_FORMAT_R32_SFLOAT, depthTargets.pyramidExtent, levelCount, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthTargets.pyramid, depthTargets.pyramidMemory);
+		depthTargets.pyramidView = createImageView(depthTargets.pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount);
+		for (uint32_t level = 0; level < levelCount; level++) {
+			depthTargets.pyramidLevelViews.push_back(createImageView(depthTargets.pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+		}
+	}
+
+	// Destroy what createDepthTargets made. Also used for the targets retired by a swap chain recreation, once the frames that used them have finished
+	void destroyDepthTargets(DepthTargets& targets) {
+		for (auto view : targets.pyramidLevelViews) {
+			vkDestroyImageView(logicalDevice, view, nullptr);
+		}
+		for (auto view : { targets.pyramidView, targets.sampledView, targets.view }) {
+			if (view != VK_NULL_HANDLE) {
+				vkDestroyImageView(logicalDevice, view, nullptr);
+			}
+		}
+		if (targets.pyramid != VK_NULL_HANDLE) {
+			vkDestroyImage(logicalDevice, targets.pyramid, nullptr);
+			gpuAllocator->free(targets.pyramidMemory);
+		}
+		if (targets.image != VK_NULL_HANDLE) {
+			vkDestroyImage(logicalDevice, targets.image, nullptr);
+			gpuAllocator->free(targets.memory);
+		}
+	}
+
+	// The compute pipeline that builds the depth pyramid one level at a time, and the sampler its levels are read through
+	void createDepthReducePipeline() {
+		VkShaderModule reduceShaderModule;
+		if (shaderManager->canCompileGLSL()) {
+			ShaderCompileOptions options{};
+			options.optimization = shaderOptimization;
+			options.debugInfo = shaderDebugInfo;
+			reduceShaderModule = shaderManager->loadGLSLModule(shaderDirectory + "/depth_reduce.comp", options);
+		}
+		else {
+			reduceShaderModule = shaderManager->loadShaderModule(shaderDirectory + "/depth_reduce.spv");
+		}
+
+		ReflectedLayout layout = pipelineLayoutCache->buildLayout({ &shaderManager->getReflection(reduceShaderModule) });
+		depthReduceLayout = layout.pipelineLayout;
+		depthReduceSetLayout = layout.setLayouts[0];
+		depthReducePipeline = createComputePipeline(reduceShaderModule, depthReduceLayout);
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &depthPyramidSampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create sampler!");
+		}
+	}
+
+	// The early culling phase binds the pyramid as GENERAL before the first build has put it in that layout, so a new pyramid is transitioned once up front.
+	// Its contents stay undefined, the early phase doesn't test against it
+	void recordPyramidInitialLayout(VkCommandBuffer commandBuffer) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = depthTargets.pyramid;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(depthTargets.pyramidLevelViews.size()), 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		depthTargets.pyramidInitialized = true;
+	}
+
+	// Record the pyramid build after the early pass: level 0 from the depth buffer, then every level from the one below
+	void recordDepthPyramid(VkCommandBuffer commandBuffer) {
+		uint32_t levelCount = static_cast<uint32_t>(depthTargets.pyramidLevelViews.size());
+
+		// every level is rewritten, so the last frame's pyramid can be discarded once its late culling phase has read it
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = depthTargets.pyramid;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipeline);
+
+		VkExtent2D sourceExtent = swapChainExtent;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			VkExtent2D levelExtent = { std::max(depthTargets.pyramidExtent.width >> level, 1u), std::max(depthTargets.pyramidExtent.height >> level, 1u) };
+			DepthReduceConstants constants{ glm::uvec2(sourceExtent.width, sourceExtent.height), glm::uvec2(levelExtent.width, levelExtent.height) };
+
+			// level i reads level i - 1, or the depth buffer for level 0. The sets live for one frame, so a recreated swap chain needs no bookkeeping
+			VkDescriptorSet reduceSet = descriptorAllocator->allocateTransient(currentFrame, depthReduceSetLayout, {
+				DescriptorResource::combinedImageSampler(0, level == 0 ? depthTargets.sampledView : depthTargets.pyramidLevelViews[level - 1], depthPyramidSampler,
+					level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL),
+				DescriptorResource::storageImage(1, depthTargets.pyramidLevelViews[level]) });
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReduceLayout, 0, 1, &reduceSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, depthReduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthReduceConstants), &constants);
+			vkCmdDispatch(commandBuffer, (levelExtent.width + 7) / 8, (levelExtent.height + 7) / 8, 1); // 8x8 texels per workgroup
+
+			// the next level and the late culling phase read this one
+			barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.subresourceRange.baseMipLevel = level;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			sourceExtent = levelExtent;
+		}
+	}
 	/*---------------------------------------------------------------------------------*/
 
-	/*-------------------------------Queues and Swapchain------------------------------*/
-	struct QueueFamilyIndices {
-		std::optional<uint32_t> graphicsFamily;
-		std::optional<uint32_t> presentFamily;
+	/*------------------------------------Geometry-------------------------------------*/
+	// Create a device local buffer and its memory
+	void createGpuBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& memory) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT; // filled by a copy from the staging ring
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // the upload manager transfers ownership from the transfer queue
+
+		if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
 
-		bool isComplete() {
-			return graphicsFamily.has_value() && presentFamily.has_value();
+		memory = gpuAllocator->allocateBuffer(buffer, MemoryUsage::GpuOnly);
+	}
+
+	// Destroy a buffer made by createGpuBuffer, if it was created
+	void destroyGpuBuffer(VkBuffer buffer, GpuAllocation& memory) {
+		if (buffer == VK_NULL_HANDLE) {
+			return;
 		}
-	};
+		vkDestroyBuffer(logicalDevice, buffer, nullptr);
+		gpuAllocator->free(memory);
+	}
 
-	struct SwapChainSupportDetails {
-		VkSurfaceCapabilitiesKHR capabilities;
-		std::vector<VkSurfaceFormatKHR> formats;
-		std::vector<VkPresentModeKHR> presentModes;
-	};
+	// Cook the mesh, encode it in the vertex format and upload it. The copies run on the transfer queue, and the first frame waits for them
+	void createMesh() {
+		MeshCooker cooker(meshCacheDirectory);
+		MeshCooker::Result cooked = meshPath.empty() ? cooker.cook(Hash::string("sphere 64x128"), []() { return MeshData::makeSphere(64, 128); }) : cooker.cookFile(meshPath);
+		EncodedMesh encoded = EncodedMesh::encode(cooked.mesh, vertexFormat);
+
+		glm::vec3 center;
+		float radius;
+		cooked.mesh.getBounds(center, radius);
+		mesh.fit = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / std::max(radius, 1e-6f))) * glm::translate(glm::mat4(1.0f), -center);
+
+		createGpuBuffer(encoded.vertexData.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, mesh.vertexBuffer, mesh.vertexMemory);
+		createGpuBuffer(encoded.indexData.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mesh.indexBuffer, mesh.indexMemory);
+		if (geometryPath == GeometryPath::MeshShader) { // fetched by the mesh shader instead of the vertex input stage
+			uploadManager->uploadBuffer(mesh.vertexBuffer, 0, encoded.vertexData.data(), encoded.vertexData.size(), VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		else {
+			uploadManager->uploadBuffer(mesh.vertexBuffer, 0, encoded.vertexData.data(), encoded.vertexData.size());
+		}
+		uploadManager->uploadBuffer(mesh.indexBuffer, 0, encoded.indexData.data(), encoded.indexData.size());
+
+		mesh.indexType = encoded.indexType;
+		mesh.indexCount = encoded.indexCount; // sizes the cluster culling path's index buffers
+		if (geometryPath != GeometryPath::Indexed) {
+			createMeshlets(cooked.mesh);
+		}
+		if (sceneInstanceCount > 0) {
+			createScene();
+		}
+
+		mesh.constants.positionScale = encoded.positionScale;
+		mesh.constants.positionOffset = glm::vec4(encoded.positionOffset, 0.0f);
+		mesh.constants.texCoordScaleOffset = glm::vec4(encoded.texCoordScale, encoded.texCoordOffset);
+
+		meshStats.vertexCount = encoded.vertexCount;
+		meshStats.indexCount = encoded.indexCount;
+		meshStats.meshletCount = mesh.meshletCount;
+		meshStats.instanceCount = sceneInstanceCount;
+		meshStats.vertexStride = vertexFormat.stride();
+		meshStats.fullPrecisionStride = vertexFormat.fullPrecision().stride();
+		meshStats.indexSize = encoded.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+		meshStats.sourceCache = cooked.before;
+		meshStats.cookedCache = cooked.after;
+		meshStats.cookedEarlier = cooked.cached;
+	}
+
+	// Split the mesh into meshlets, upload them for the culling shaders and create the descriptor sets they read them through. The cluster culling path also
+	// gets an index buffer and an indirect draw per frame for the compute pass to fill
+	void createMeshlets(const MeshData& source) {
+		MeshletData meshlets = MeshletData::build(source);
+		mesh.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+
+		VkPipelineStageFlags readStage = geometryPath == GeometryPath::MeshShader ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		auto createMeshletBuffer = [&](const void* data, VkDeviceSize size, VkBuffer& buffer, GpuAllocation& memory) {
+			createGpuBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer, memory);
+			uploadManager->uploadBuffer(buffer, 0, data, size, readStage, VK_ACCESS_SHADER_READ_BIT);
+		};
+		createMeshletBuffer(meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(Meshlet), mesh.meshletBuffer, mesh.meshletMemory);
+		createMeshletBuffer(meshlets.bounds.data(), meshlets.bounds.size() * sizeof(MeshletBounds), mesh.meshletBoundsBuffer, mesh.meshletBoundsMemory);
+		createMeshletBuffer(meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t), mesh.meshletVertexBuffer, mesh.meshletVertexMemory);
+		createMeshletBuffer(meshlets.triangles.data(), meshlets.triangles.size() * sizeof(uint32_t), mesh.meshletTriangleBuffer, mesh.meshletTriangleMemory);
+
+		if (geometryPath == GeometryPath::MeshShader) {
+			meshletSet = getStorageBufferSet(meshletSetLayout, { mesh.meshletBuffer, mesh.meshletBoundsBuffer, mesh.meshletVertexBuffer, mesh.meshletTriangleBuffer, mesh.vertexBuffer });
+			return;
+		}
+
+		for (auto& frame : frames) {
+			createGpuBuffer(static_cast<VkDeviceSize>(mesh.indexCount) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, frame.culledIndexBuffer, frame.culledIndexMemory);
+			createGpuBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, frame.drawCommandBuffer, frame.drawCommandMemory);
+			frame.clusterCullSet = getStorageBufferSet(meshletSetLayout, { mesh.meshletBuffer, mesh.meshletBoundsBuffer, mesh.meshletVertexBuffer, mesh.meshletTriangleBuffer, frame.culledIndexBuffer, frame.drawCommandBuffer });
+		}
+	}
+
+	// Lay the scene's instances out on a grid around the camera, upload them and create the descriptor sets that read them. GPU-driven rendering also gets
+	// a draw command buffer and a draw count per frame for the culling passes to fill, and the visibility the occlusion test carries from frame to frame
+	void createScene() {
+		const float spacing = 3.0f; // the mesh is fit to a unit sphere
+		uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(sceneInstanceCount))));
+		sceneExtent = spacing * static_cast<float>(side);
+
+		sceneInstances.resize(sceneInstanceCount);
+		for (uint32_t i = 0; i < sceneInstanceCount; i++) {
+			glm::vec3 position((static_cast<float>(i % side) - static_cast<float>(side - 1) * 0.5f) * spacing, 0.0f, (static_cast<float>(i / side) - static_cast<float>(side - 1) * 0.5f) * spacing);
+			sceneInstances[i].model = glm::translate(glm::mat4(1.0f), position) * glm::rotate(glm::mat4(1.0f), static_cast<float>(i) * 0.7f, glm::vec3(0.0f, 1.0f, 0.0f))
+				* glm::rotate(glm::mat4(1.0f), 0.4f, glm::vec3(1.0f, 0.0f, 0.0f)) * mesh.fit;
+			sceneInstances[i].bounds = glm::vec4(position, 1.0f); // the fit puts the mesh in a unit sphere around the origin, the rotations keep it there
+		}
+
+		VkDeviceSize size = sceneInstances.size() * sizeof(SceneInstance);
+		createGpuBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceBuffer, instanceMemory);
+		uploadManager->uploadBuffer(instanceBuffer, 0, sceneInstances.data(), size, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | (gpuDriven ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : 0), VK_ACCESS_SHADER_READ_BIT);
+		if (bindless) {
+			mesh.constants.instanceBuffer = bindlessTable->addBuffer(instanceBuffer);
+		}
+		else {
+			instanceSet = getStorageBufferSet(instanceSetLayout, { instanceBuffer });
+		}
+		viewUniformSet = descriptorAllocator->getPersistent(viewSetLayout, { DescriptorResource::dynamicUniformBuffer(0, uniformRing->getBuffer(), sizeof(ViewUniforms)) });
+
+		if (!gpuDriven) {
+			return;
+		}
+
+		// nothing was visible before the first frame, so its early pass draws nothing and its late pass tests every instance against an empty pyramid
+		std::vector<uint32_t> visibility(sceneInstances.size(), 0);
+		createGpuBuffer(visibility.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceVisibilityBuffer, instanceVisibilityMemory);
+		uploadManager->uploadBuffer(instanceVisibilityBuffer, 0, visibility.data(), visibility.size() * sizeof(uint32_t), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		for (auto& frame : frames) {
+			createGpuBuffer(sceneInstances.size() * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, frame.instanceDrawBuffer, frame.instanceDrawMemory);
+			createGpuBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, frame.instanceDrawCountBuffer, frame.instanceDrawCountMemory);
+		}
+	}
+
+	// The cached set that points binding i at the whole of buffers[i]
+	VkDescriptorSet getStorageBufferSet(VkDescriptorSetLayout setLayout, const std::vector<VkBuffer>& buffers) {
+		std::vector<DescriptorResource> resources;
+		for (size_t i = 0; i < buffers.size(); i++) {
+			resources.push_back(DescriptorResource::storageBuffer(static_cast<uint32_t>(i), buffers[i]));
+		}
+		return descriptorAllocator->getPersistent(setLayout, resources);
+	}
+
+	// The compute pipeline of the cluster culling path. It culls meshlets and compacts the surviving triangles into the frame's index buffer
+	void createClusterCullPipeline() {
+		VkShaderModule cullShaderModule;
+		if (shaderManager->canCompileGLSL()) {
+			ShaderCompileOptions options{};
+			options.optimization = shaderOptimization;
+			options.debugInfo = shaderDebugInfo;
+			cullShaderModule = shaderManager->loadGLSLModule(shaderDirectory + "/meshlet_cull.comp", options);
+		}
+		else {
+			cullShaderModule = shaderManager->loadShaderModule(shaderDirectory + "/meshlet_cull.spv");
+		}
+
+		ReflectedLayout layout = pipelineLayoutCache->buildLayout({ &shaderManager->getReflection(cullShaderModule) });
+		clusterCullLayout = layout.pipelineLayout;
+		meshletSetLayout = layout.setLayouts[0];
+		clusterCullPipeline = createComputePipeline(cullShaderModule, clusterCullLayout);
+	}
+
+	// The compute pipeline of GPU-driven rendering. It culls the scene's instances and writes a draw command for each one that is visible
+	void createInstanceCullPipeline() {
+		VkShaderModule cullShaderModule;
+		if (shaderManager->canCompileGLSL()) {
+			ShaderCompileOptions options{};
+			options.optimization = shaderOptimization;
+			options.debugInfo = shaderDebugInfo;
+			cullShaderModule = shaderManager->loadGLSLModule(shaderDirectory + "/instance_cull.comp", options);
+		}
+		else {
+			cullShaderModule = shaderManager->loadShaderModule(shaderDirectory + "/instance_cull.spv");
+		}
+
+		ReflectedLayout layout = pipelineLayoutCache->buildLayout({ &shaderManager->getReflection(cullShaderModule) });
+		instanceCullLayout = layout.pipelineLayout;
+		instanceCullSetLayout = layout.setLayouts[0];
+		instanceCullPipeline = createComputePipeline(cullShaderModule, instanceCullLayout);
+	}
+
+	// Culling shaders are single small modules, compiled up front instead of going through the background compiler
+	VkPipeline createComputePipeline(VkShaderModule module, VkPipelineLayout layout) {
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = module;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(logicalDevice, pipelineCache->getHandle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+		return pipeline;
+	}
+
+	// The mesh's push constants for the current frame, spinning it a little further every frame
+	MeshPushConstants getMeshConstants() {
+		float aspect = static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
+		float angle = static_cast<float>(frameStats.framesSubmitted) * 0.01f;
+
+		glm::mat4 model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::rotate(glm::mat4(1.0f), 0.4f, glm::vec3(1.0f, 0.0f, 0.0f)) * mesh.fit;
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		// perspective, so the back-face cones cull from the camera's actual position. Depth goes to Vulkan's [0, 1] and y is flipped to its y-down clip space
+		glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(45.0f), aspect, 0.1f, 10.0f);
+		projection[1][1] *= -1.0f;
+
+		MeshPushConstants constants = mesh.constants;
+		if (sceneInstanceCount > 0) { // a camera turning in place in the middle of the grid, so most of the scene is outside the frustum at any time
+			glm::vec3 eye(0.0f, 2.0f, 0.0f);
+			glm::vec3 forward(std::sin(angle), -0.2f, -std::cos(angle));
+			glm::mat4 sceneProjection = glm::perspectiveRH_ZO(glm::radians(45.0f), aspect, 0.1f, sceneExtent);
+			sceneProjection[1][1] *= -1.0f;
+
+			constants.transform = sceneProjection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)); // the instances bring their own model matrices
+			constants.cameraPosition = glm::vec4(eye, 1.0f);
+			return constants;
+		}
+
+		constants.transform = projection * view * model;
+		constants.cameraPosition = glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // model space, where the meshlet bounds are
+		return constants;
+	}
+
+	// Record the cluster culling pass ahead of the render pass: reset the frame's indirect draw, cull the meshlets into it and make the result visible to the draw
+	void recordClusterCulling(VkCommandBuffer commandBuffer, const MeshPushConstants& constants) {
+		FrameData& frame = frames[currentFrame];
+
+		VkDrawIndexedIndirectCommand emptyDraw{ 0, 1, 0, 0, 0 }; // the culling shader adds the index count
+		vkCmdUpdateBuffer(commandBuffer, frame.drawCommandBuffer, 0, sizeof(emptyDraw), &emptyDraw);
+
+		VkBufferMemoryBarrier resetBarrier{};
+		resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.buffer = frame.drawCommandBuffer;
+		resetBarrier.offset = 0;
+		resetBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterCullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterCullLayout, 0, 1, &frame.clusterCullSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, clusterCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshPushConstants), &constants);
+		vkCmdDispatch(commandBuffer, mesh.meshletCount, 1, 1); // one workgroup per meshlet
+
+		VkBufferMemoryBarrier cullBarriers[2] = { resetBarrier, resetBarrier };
+		cullBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarriers[0].dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+		cullBarriers[0].buffer = frame.culledIndexBuffer;
+		cullBarriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarriers[1].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		cullBarriers[1].buffer = frame.drawCommandBuffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 2, cullBarriers, 0, nullptr);
+	}
+
+	// The six planes bounding what a world to clip transform can see, normalized and pointing inward. Depth is clipped to Vulkan's [0, w]
+	static void extractFrustumPlanes(const glm::mat4& transform, glm::vec4 planes[6]) {
+		glm::mat4 rows = glm::transpose(transform);
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[2];
+		planes[5] = rows[3] - rows[2];
+		for (int i = 0; i < 6; i++) {
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+	}
+
+	// Record one phase of GPU-driven culling ahead of its render pass: reset the frame's draw count, write a draw command for every instance the phase draws
+	// and make them visible to the indirect draw
+	void recordInstanceCulling(VkCommandBuffer commandBuffer, const MeshPushConstants& constants, bool latePhase) {
+		FrameData& frame = frames[currentFrame];
+
+		// a set per phase and frame, so it always points at the current pyramid even after the swap chain has been recreated
+		VkDescriptorSet cullSet = descriptorAllocator->allocateTransient(currentFrame, instanceCullSetLayout, {
+			DescriptorResource::storageBuffer(0, instanceBuffer),
+			DescriptorResource::storageBuffer(1, frame.instanceDrawBuffer),
+			DescriptorResource::storageBuffer(2, frame.instanceDrawCountBuffer),
+			DescriptorResource::storageBuffer(3, instanceVisibilityBuffer),
+			DescriptorResource::combinedImageSampler(4, depthTargets.pyramidView, depthPyramidSampler, VK_IMAGE_LAYOUT_GENERAL) });
+
+		// the draw buffers' last indirect draw has to be done before they are overwritten, and the visibility the last phase wrote has to be visible
+		VkMemoryBarrier previousBarrier{};
+		previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		previousBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		previousBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdFillBuffer(commandBuffer, frame.instanceDrawCountBuffer, 0, sizeof(uint32_t), 0);
+
+		VkBufferMemoryBarrier resetBarrier{};
+		resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.buffer = frame.instanceDrawCountBuffer;
+		resetBarrier.offset = 0;
+		resetBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+		InstanceCullConstants cullConstants{};
+		cullConstants.viewProjection = constants.transform;
+		cullConstants.instanceCount = sceneInstanceCount;
+		cullConstants.indexCount = mesh.indexCount;
+		cullConstants.latePhase = latePhase ? 1 : 0;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullLayout, 0, 1, &cullSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, instanceCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(InstanceCullConstants), &cullConstants);
+		vkCmdDispatch(commandBuffer, (sceneInstanceCount + 63) / 64, 1, 1); // 64 instances per workgroup
+
+		VkBufferMemoryBarrier cullBarriers[2] = { resetBarrier, resetBarrier };
+		cullBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		cullBarriers[0].buffer = frame.instanceDrawBuffer;
+		cullBarriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarriers[1].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		cullBarriers[1].buffer = frame.instanceDrawCountBuffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 2, cullBarriers, 0, nullptr);
+	}
+
+	// Record the scene's draws: a single indirect draw whose count the culling pass wrote, or one CPU-issued draw per instance the CPU finds in the frustum
+	void recordSceneDraws(VkCommandBuffer commandBuffer, const MeshPushConstants& constants) {
+		ScenePushConstants sceneConstants{ constants.positionScale, constants.instanceBuffer, constants.positionOffset, constants.texCoordScaleOffset };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, 0, sizeof(ScenePushConstants), &sceneConstants);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, viewSet, 1, &viewUniformSet, 1, &viewUniformOffset);
+
+		vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+		if (bindless) { // the table holds every resource, so this is the only bind however many draws and resources follow
+			VkDescriptorSet table = bindlessTable->getSet();
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindlessSet, 1, &table, 0, nullptr);
+		}
+		else {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &instanceSet, 0, nullptr);
+		}
+
+		if (gpuDriven) {
+			vkCmdDrawIndexedIndirectCount(commandBuffer, frames[currentFrame].instanceDrawBuffer, 0, frames[currentFrame].instanceDrawCountBuffer, 0, sceneInstanceCount, sizeof(VkDrawIndexedIndirectCommand));
+			frameStats.drawCalls++;
+			return;
+		}
+
+		glm::vec4 planes[6];
+		extractFrustumPlanes(constants.transform, planes);
+		for (uint32_t i = 0; i < sceneInstanceCount; i++) {
+			const glm::vec4& bounds = sceneInstances[i].bounds;
+			bool visible = true;
+			for (const auto& plane : planes) {
+				visible = visible && glm::dot(glm::vec3(plane), glm::vec3(bounds)) + plane.w >= -bounds.w;
+			}
+
+			if (visible) {
+				vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, i); // the first instance picks the instance's transform
+				frameStats.drawCalls++;
+			}
+		}
+	}
+
+	// Record the mesh's draw on the device's geometry path
+	void recordMeshDraw(VkCommandBuffer commandBuffer, const MeshPushConstants& constants) {
+		if (sceneInstanceCount == 0) { // the scene pushes its own, smaller constants
+			vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, 0, sizeof(MeshPushConstants), &constants);
+		}
+
+		if (geometryPath == GeometryPath::MeshShader) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &meshletSet, 0, nullptr);
+			vkCmdDrawMeshTasks(commandBuffer, (mesh.meshletCount + meshletsPerTask - 1) / meshletsPerTask, 1, 1);
+			frameStats.drawCalls++;
+			return;
+		}
+
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+
+		if (sceneInstanceCount > 0) {
+			recordSceneDraws(commandBuffer, constants);
+		}
+		else if (geometryPath == GeometryPath::ClusterCulling) { // the triangles that survived culling, in the order the compute pass wrote them
+			vkCmdBindIndexBuffer(commandBuffer, frames[currentFrame].culledIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexedIndirect(commandBuffer, frames[currentFrame].drawCommandBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+			frameStats.drawCalls++;
+		}
+		else {
+			vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+			vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
+			frameStats.drawCalls++;
+		}
+	}
+	/*---------------------------------------------------------------------------------*/
+
+	/*---------------------------------Frames in Flight--------------------------------*/
+	// Create the command pool, command buffer and synchronization objects for every frame in flight
+	void createFrameResources() {
+		if (headless && swapChainImages.size() != framesInFlight) {
+			throw std::runtime_error("headless mode needs one render target per frame in flight!");
+		}
+
+		frames.resize(framesInFlight);
+		imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+		for (auto& frame : frames) {
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // command buffers are re-recorded every frame, and the whole pool is reset at once instead of resetting individual buffers
+			poolInfo.queueFamilyIndex = queueTopology.graphics.family;
+
+			if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = frame.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // primary buffers are submitted directly to a queue, secondary buffers are called from primary buffers
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate command buffers!");
+			}
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // start signaled so the first wait on each frame returns immediately
+
+			if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+				vkCreateFence(logicalDevice, &fenceInfo, nullptr, &frame.inFlightFence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create synchronization objects for a frame!");
+			}
+
+			if (transfersImageOwnership() && vkCreateFence(logicalDevice, &fenceInfo, nullptr, &frame.presentAcquiredFence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create synchronization objects for a frame!");
+			}
+
+			if (headless) {
+				createReadbackBuffer(frame);
+			}
+		}
+	}
+
+	// Reload shaders that changed on disk and rebuild the pipelines using them. The rebuilds compile in the background, once they are done the new pipelines are
+	// swapped in and the old ones are retired until the frames still using them have finished
+	void processShaderChanges() {
+		for (const auto& path : shaderWatcher->pollChanges()) {
+			if (ShaderCompiler::isSourcePath(path)) { // GLSL loaded through the runtime compiler is recompiled in the background and picked up on a later frame
+				for (auto& reload : shaderManager->recompileGLSLAsync(path)) {
+					pendingShaderReloads.push_back(std::move(reload));
+				}
+				continue;
+			}
+
+			// without runtime compilation, source files are picked up once compile_shaders has turned them into SPIR-V
+			if (std::filesystem::path(path).extension() != ".spv") {
+				continue;
+			}
+
+			VkShaderModule oldModule = shaderManager->getLoadedModule(path);
+			if (oldModule == VK_NULL_HANDLE) {
+				continue; // not used by anything
+			}
+
+			try {
+				VkShaderModule newModule = shaderManager->reloadShaderModule(path);
+				if (newModule != oldModule) {
+					trianglePermutations->replaceModule(oldModule, newModule);
+					uint32_t rebuildCount = pipelineRegistry->rebuildPipelinesUsing(oldModule, newModule);
+					std::cout << "reloaded " << path << ", rebuilding " << rebuildCount << " pipeline(s)" << std::endl;
+				}
+			}
+			catch (const std::exception& e) {
+				std::cerr << "failed to reload " << path << ": " << e.what() << std::endl; // a half written file or a bad compile shouldn't take the engine down
+			}
+		}
+
+		for (auto reload = pendingShaderReloads.begin(); reload != pendingShaderReloads.end();) {
+			if (reload->code.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++reload;
+				continue;
+			}
+
+			try {
+				VkShaderModule previousModule;
+				VkShaderModule newModule = shaderManager->finishGLSLReload(*reload, previousModule);
+				if (newModule != VK_NULL_HANDLE && newModule != previousModule) {
+					trianglePermutations->replaceModule(previousModule, newModule);
+					uint32_t rebuildCount = pipelineRegistry->rebuildPipelinesUsing(previousModule, newModule);
+					std::cout << "recompiled shader, rebuilding " << rebuildCount << " pipeline(s)" << std::endl;
+				}
+			}
+			catch (const std::exception& e) {
+				std::cerr << e.what() << std::endl; // keep the last good shader until the source is fixed
+			}
+			reload = pendingShaderReloads.erase(reload);
+		}
 
-	//TODO: Optimize this function to choose the best available queue families for the operations we need. Currently it just chooses the first one that supports the operations meaning that one queue might be fulfilling multiple tasks, which isn't optimal
-	// Find the queue families that are supported by the physical device for specific operations
-	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
-		QueueFamilyIndices indices;
+		VkDevice device = logicalDevice;
+		for (VkPipeline oldPipeline : pipelineCompiler->publishRebuilds()) {
+			deletionQueue.retire(frameStats.framesSubmitted, [device, oldPipeline]() {
+				vkDestroyPipeline(device, oldPipeline, nullptr);
+			});
+		}
 
-		// Logic to find queue family indices to populate struct with
-		uint32_t queueFamilyCount = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+		// a compile still running may have been started from a replaced module, so they are only let go once the compiler has caught up
+		for (VkShaderModule oldModule : shaderManager->takeSupersededModules()) {
+			supersededShaderModules.push_back(oldModule);
+		}
+		if (!supersededShaderModules.empty() && pipelineCompiler->pendingCount() == 0) {
+			std::vector<VkShaderModule> oldModules = std::move(supersededShaderModules);
+			supersededShaderModules.clear();
+			deletionQueue.retire(frameStats.framesSubmitted, [device, oldModules]() {
+				for (VkShaderModule oldModule : oldModules) {
+					vkDestroyShaderModule(device, oldModule, nullptr);
+				}
+			});
+		}
+	}
+
+	// Block until the GPU is done with a fence, recording in the frame stats whether the CPU actually had to wait
+	void waitForFence(VkFence fence) {
+		if (vkGetFenceStatus(logicalDevice, fence) == VK_SUCCESS) {
+			return; // the GPU is already done, no stall
+		}
+
+		auto waitStart = std::chrono::steady_clock::now();
+		vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+		auto waitEnd = std::chrono::steady_clock::now();
+
+		frameStats.fenceWaits++;
+		frameStats.fenceWaitMilliseconds += std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
+	}
 
-		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	// Acquire a swap chain image, record the frame into the current frame's command buffer, submit it and present it
+	void drawFrame() {
+		FrameData& frame = frames[currentFrame];
 
-		VkBool32 presentSupport;
-		int i = 0;
-		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) { // find the first queue family that supports graphics operations
-				indices.graphicsFamily = i;
+		framePacer.waitForNextFrame(); // returns immediately unless a target frame rate is set
+
+		// wait until the GPU is done with the last frame that used this slot, only then can its command pool and semaphores be reused
+		waitForFence(frame.inFlightFence);
+		if (frame.presentAcquiredFence != VK_NULL_HANDLE) { // and the present queue with its half of the ownership transfer
+			waitForFence(frame.presentAcquiredFence);
+		}
+
+		// frames are submitted to each queue in order and finish in order, so once this slot's fences have signaled every frame up to it has finished too
+		if (frameStats.framesSubmitted >= framesInFlight) {
+			completedFrames = std::max(completedFrames, frameStats.framesSubmitted - framesInFlight + 1);
+		}
+		deletionQueue.collect(completedFrames);
+		uploadManager->collect(completedFrames);
+
+		if (shaderWatcher) {
+			processShaderChanges();
+		}
+
+		if (headless) {
+			drawHeadlessFrame(frame);
+			return;
+		}
+
+		uint32_t imageIndex;
+		VkResult result = vkAcquireNextImageKHR(logicalDevice, swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) { // the swap chain can no longer be presented to, recreate it and try again next frame
+			recreateSwapChain();
+			return;
+		}
+		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) { // a suboptimal swap chain can still be presented to, so finish the frame and recreate it afterwards
+			throw std::runtime_error("failed to acquire swap chain image!");
+		}
+
+		// the image may still be in use by an older frame if the swap chain has more images than we have frames in flight
+		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+			waitForFence(imagesInFlight[imageIndex]);
+		}
+		imagesInFlight[imageIndex] = frame.inFlightFence;
+
+		latencyMonitor->release(frame.latencyTicket);
+		vkResetFences(logicalDevice, 1, &frame.inFlightFence);
+
+		vkResetCommandPool(logicalDevice, frame.commandPool, 0); // resets every command buffer allocated from the pool at once
+		descriptorAllocator->beginFrame(currentFrame); // likewise every descriptor set the frame allocated the last time the slot was used
+		uniformRing->beginFrame(currentFrame);
+		frameUploads = uploadManager->takeHandoff(frameStats.framesSubmitted);
+		recordCommandBuffer(frame.commandBuffer, imageIndex);
+		uniformRing->flush();
+
+		// only writing to the image has to wait for it to be acquired, vertex work can start right away. Uploaded data is waited for where it is first read
+		std::vector<VkSemaphore> waitSemaphores = { frame.imageAvailableSemaphore };
+		std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		for (VkSemaphore semaphore : frameUploads.semaphores) {
+			waitSemaphores.push_back(semaphore);
+			waitStages.push_back(frameUploads.waitStage);
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &renderFinishedSemaphores[imageIndex];
+
+		framePacer.markSubmit();
+		LatencyMonitor::Clock::time_point submitTime = LatencyMonitor::Clock::now();
+
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+		frame.latencyTicket = latencyMonitor->track(frame.inFlightFence, submitTime);
+
+		VkSemaphore presentWaitSemaphore = renderFinishedSemaphores[imageIndex];
+		if (transfersImageOwnership()) { // the present queue takes the image over before presenting it
+			VkPipelineStageFlags acquireWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+			VkSubmitInfo acquireInfo{};
+			acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			acquireInfo.waitSemaphoreCount = 1;
+			acquireInfo.pWaitSemaphores = &renderFinishedSemaphores[imageIndex];
+			acquireInfo.pWaitDstStageMask = &acquireWaitStage;
+			acquireInfo.commandBufferCount = 1;
+			acquireInfo.pCommandBuffers = &presentAcquireCommandBuffers[imageIndex];
+			acquireInfo.signalSemaphoreCount = 1;
+			acquireInfo.pSignalSemaphores = &presentAcquiredSemaphores[imageIndex];
+
+			vkResetFences(logicalDevice, 1, &frame.presentAcquiredFence);
+			if (vkQueueSubmit(presentQueue, 1, &acquireInfo, frame.presentAcquiredFence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit present acquire command buffer!");
 			}
+			presentWaitSemaphore = presentAcquiredSemaphores[imageIndex];
+		}
+
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &presentWaitSemaphore; // don't present until rendering is done
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &swapChain;
+		presentInfo.pImageIndices = &imageIndex;
+
+		// tag the present so the driver can report when it reached the display
+		VkPresentTimeGOOGLE presentTime{ static_cast<uint32_t>(frameStats.framesSubmitted + 1), 0 }; // no desired time, present as usual
+		VkPresentTimesInfoGOOGLE presentTimes{};
+		presentTimes.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+		presentTimes.swapchainCount = 1;
+		presentTimes.pTimes = &presentTime;
+		if (latencyMonitor->hasDisplayTiming()) {
+			presentInfo.pNext = &presentTimes;
+			latencyMonitor->trackPresent(presentTime.presentID, submitTime);
+		}
+
+		result = vkQueuePresentKHR(presentQueue, &presentInfo);
+
+		framePacer.markPresent();
+		latencyMonitor->collectPresentTimes(swapChain);
+
+		frameStats.framesSubmitted++;
+		currentFrame = (currentFrame + 1) % framesInFlight;
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized || presentModeChanged) {
+			framebufferResized = false;
+			presentModeChanged = false;
+			recreateSwapChain();
+		}
+		else if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to present swap chain image!");
+		}
+	}
+
+	// Record a render pass over the given swap chain image that draws the mesh
+	void recordRenderPass(VkCommandBuffer commandBuffer, VkRenderPass pass, uint32_t imageIndex, const MeshPushConstants& constants) {
+		VkClearValue clearValues[2]{};
+		clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+		clearValues[1].depthStencil = { 1.0f, 0 }; // the far plane
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = pass;
+		renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = swapChainExtent;
+		renderPassInfo.clearValueCount = 2;
+		renderPassInfo.pClearValues = clearValues; // used by VK_ATTACHMENT_LOAD_OP_CLEAR
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkPipeline pipeline = pipelineCompiler->waitForPipeline(trianglePipeline); // the variant's fallback until the background compile is done
+		if (pipeline != VK_NULL_HANDLE) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		}
+
+		// viewport and scissor are dynamic state in the pipeline, so they have to be set before drawing
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(swapChainExtent.width);
+		viewport.height = static_cast<float>(swapChainExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = swapChainExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		if (pipeline != VK_NULL_HANDLE) {
+			recordMeshDraw(commandBuffer, constants);
+		}
 
-			presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// Record the commands that draw a frame into the given swap chain image
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // the buffer is re-recorded every frame
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
 
-			if (presentSupport) { // find the first queue family that supports presenting to the surface. This may be the same as the graphics queue family
-				indices.presentFamily = i;
+		UploadManager::recordAcquire(commandBuffer, frameUploads); // take ownership of this frame's uploads before anything reads them
+
+		MeshPushConstants meshConstants = getMeshConstants();
+		if (sceneInstanceCount > 0) { // written once, every pass and draw of the frame reads the same slice
+			viewUniformOffset = uniformRing->push(ViewUniforms{ meshConstants.transform, meshConstants.cameraPosition });
+		}
+		if (geometryPath == GeometryPath::ClusterCulling) {
+			recordClusterCulling(commandBuffer, meshConstants); // compute work can't be recorded inside a render pass
+		}
+
+		if (gpuDriven) { // two-phase occlusion culling, see instance_cull.comp
+			if (!depthTargets.pyramidInitialized) {
+				recordPyramidInitialLayout(commandBuffer);
 			}
+			recordInstanceCulling(commandBuffer, meshConstants, false);
+			recordRenderPass(commandBuffer, earlyRenderPass, imageIndex, meshConstants);
+			recordDepthPyramid(commandBuffer);
+			recordInstanceCulling(commandBuffer, meshConstants, true);
+		}
+		recordRenderPass(commandBuffer, renderPass, imageIndex, meshConstants);
 
-			if (indices.isComplete()) {
-				break;
+		if (headless) {
+			recordReadbackCopy(commandBuffer, imageIndex);
+		}
+
+		if (transfersImageOwnership()) {
+			recordImageOwnershipBarrier(commandBuffer, swapChainImages[imageIndex], true);
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
+	/*---------------------------------------------------------------------------------*/
+
+	/*---------------------------------Headless Rendering------------------------------*/
+	// Create engine-owned images to render into in place of swap chain images, one per frame in flight. They are stored in swapChainImages so image views,
+	// framebuffers and command recording work the same in both modes
+	void createOffscreenTargets() {
+		swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM; // universally supported as a color attachment and simple to consume on the CPU
+		swapChainExtent = { WIDTH, HEIGHT };
+
+		swapChainImages.resize(framesInFlight);
+		offscreenImageMemory.resize(framesInFlight);
+
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = swapChainImageFormat;
+			imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL; // let the driver pick the layout, the copy to the staging buffer linearizes it
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &swapChainImages[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create offscreen image!");
 			}
 
-			i++;
+			offscreenImageMemory[i] = gpuAllocator->allocateImage(swapChainImages[i], MemoryUsage::GpuOnly);
+		}
+	}
+
+	// Create the host visible staging buffer a frame's render target is copied into
+	void createReadbackBuffer(FrameData& frame) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4; // 4 bytes per RGBA8 pixel
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &frame.readbackBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create readback buffer!");
 		}
 
-		return indices;
+		frame.readbackMemory = gpuAllocator->allocateBuffer(frame.readbackBuffer, MemoryUsage::Readback); // cached memory makes CPU reads fast
+	}
+
+	// Headless version of drawFrame -- renders into the frame's own target, no acquire or present
+	void drawHeadlessFrame(FrameData& frame) {
+		deliverReadback(frame); // the fence has signaled, so the copy recorded the last time this slot was used has landed
+
+		latencyMonitor->release(frame.latencyTicket);
+		vkResetFences(logicalDevice, 1, &frame.inFlightFence);
+
+		vkResetCommandPool(logicalDevice, frame.commandPool, 0);
+		descriptorAllocator->beginFrame(currentFrame);
+		uniformRing->beginFrame(currentFrame);
+		frameUploads = uploadManager->takeHandoff(frameStats.framesSubmitted);
+		recordCommandBuffer(frame.commandBuffer, currentFrame); // each frame in flight renders to its own target
+		uniformRing->flush();
+
+		std::vector<VkPipelineStageFlags> waitStages(frameUploads.semaphores.size(), frameUploads.waitStage);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(frameUploads.semaphores.size());
+		submitInfo.pWaitSemaphores = frameUploads.semaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+		framePacer.markSubmit();
+		LatencyMonitor::Clock::time_point submitTime = LatencyMonitor::Clock::now();
+
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+		frame.latencyTicket = latencyMonitor->track(frame.inFlightFence, submitTime);
+
+		framePacer.markPresent();
+
+		frame.readbackPending = true;
+		frame.readbackFrameNumber = frameStats.framesSubmitted;
+
+		frameStats.framesSubmitted++;
+		currentFrame = (currentFrame + 1) % framesInFlight;
+	}
+
+	// Copy the rendered image into the frame's staging buffer and make the copy visible to the host
+	void recordReadbackCopy(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0; // tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+		// the render pass already left the image in TRANSFER_SRC_OPTIMAL
+		vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frames[currentFrame].readbackBuffer, 1, &region);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = frames[currentFrame].readbackBuffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	// Hand a finished frame's pixels to the readback callback. The frame's fence must have signaled
+	void deliverReadback(FrameData& frame) {
+		if (!frame.readbackPending) {
+			return;
+		}
+		frame.readbackPending = false;
+
+		if (!readbackCallback) {
+			return;
+		}
+
+		gpuAllocator->invalidate(frame.readbackMemory); // non-coherent memory has to be invalidated before the CPU can see what the GPU wrote
+
+		FrameReadback readback{};
+		readback.frameNumber = frame.readbackFrameNumber;
+		readback.width = swapChainExtent.width;
+		readback.height = swapChainExtent.height;
+		readback.rowPitch = swapChainExtent.width * 4;
+		readback.format = swapChainImageFormat;
+		readback.pixels = static_cast<const uint8_t*>(frame.readbackMemory.mapped);
+
+		readbackCallback(readback);
+	}
+	/*---------------------------------------------------------------------------------*/
+
+	/*-------------------------------Queues and Swapchain------------------------------*/
+
+	struct SwapChainSupportDetails {
+		VkSurfaceCapabilitiesKHR capabilities;
+		std::vector<VkSurfaceFormatKHR> formats;
+		std::vector<VkPresentModeKHR> presentModes;
+	};
+
+	// Find the queue families and queues the device offers for each kind of work, preferring dedicated compute and transfer families
+	QueueTopology findQueueFamilies(VkPhysicalDevice device) {
+		return QueueTopology::select(device, headless ? VK_NULL_HANDLE : surface); // nothing is presented without a surface, present then follows graphics
 	}
 	
 	// Return the swap chain support details for the physical device
@@ -659,11 +2518,11 @@ private:
 		return availableFormats[0]; // For now, if the desired format is not available, just return the first available format
 	}
 
-	// Presentation mode specifies the conditions for "swapping" the image to the screen, known as Vertical Sync (Vsync).
+	// Presentation mode specifies the conditions for "swapping" the image to the screen, known as Vertical Sync (Vsync). Uses the mode chosen with setPresentMode
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
 		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) { // prefered mode is triple buffering, but Vsync off is VK_PRESENT_MODE_IMMEDIATE_KHR
-				return availablePresentMode; // TODO: allow user to choose their prefered presentation mode (VySync on/off)
+			if (availablePresentMode == preferredPresentMode) {
+				return availablePresentMode;
 			}
 		}
 		return VK_PRESENT_MODE_FIFO_KHR; // guaranteed to be available -- regular Vsync
@@ -690,6 +2549,165 @@ private:
 		}
 	}
 
+	// Replace the swap chain after a resize without waiting for the device to go idle. The current swap chain is handed to the new one as oldSwapchain so
+	// presentation keeps going, and the old swap chain, image views, framebuffers and depth targets are destroyed once the frames that used them have finished
+	void recreateSwapChain() {
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		while (width == 0 || height == 0) { // a minimized window has no size to render to, so wait until it is restored
+			glfwGetFramebufferSize(window, &width, &height);
+			glfwWaitEvents();
+		}
+
+		VkSwapchainKHR oldSwapChain = swapChain;
+		std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews);
+		std::vector<VkFramebuffer> oldFramebuffers = std::move(swapChainFramebuffers);
+
+		// The render pass and pipeline only depend on the image format, which doesn't change when the surface is resized, so they are kept
+		std::vector<VkCommandBuffer> oldAcquireCommands = std::move(presentAcquireCommandBuffers);
+		std::vector<VkSemaphore> oldRenderFinished = std::move(renderFinishedSemaphores);
+		std::vector<VkSemaphore> oldPresentAcquired = std::move(presentAcquiredSemaphores);
+
+		DepthTargets oldDepthTargets = std::move(depthTargets);
+		depthTargets = DepthTargets{};
+
+		latencyMonitor->forgetPresents(); // the old swap chain's presents won't be reported anymore
+		createSwapChain(); // passes the current swapChain as oldSwapchain
+		createImageSemaphores();
+		createPresentAcquireCommands();
+		createImageViews();
+		createDepthTargets();
+		createFramebuffers();
+
+		imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE); // the new images haven't been used by any frame yet
+
+		VkDevice device = logicalDevice;
+		VkCommandPool commandPool = presentCommandPool;
+		deletionQueue.retire(frameStats.framesSubmitted, [device, oldSwapChain, oldImageViews, oldFramebuffers, commandPool, oldAcquireCommands, oldRenderFinished, oldPresentAcquired]() mutable {
+			destroyImageSemaphores(device, oldRenderFinished, oldPresentAcquired);
+			if (!oldAcquireCommands.empty()) {
+				vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(oldAcquireCommands.size()), oldAcquireCommands.data());
+			}
+			for (auto framebuffer : oldFramebuffers) {
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			for (auto imageView : oldImageViews) {
+				vkDestroyImageView(device, imageView, nullptr);
+			}
+			vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+		});
+		deletionQueue.retire(frameStats.framesSubmitted, [this, oldDepthTargets]() mutable {
+			destroyDepthTargets(oldDepthTargets);
+		});
+	}
+
+	// Whether swap chain images change queue family between rendering and presenting
+	bool transfersImageOwnership() const {
+		return !headless && queueTopology.graphics.family != queueTopology.present.family && queueTopology.presentRecordsCommands;
+	}
+
+	// A present-only family can't record the acquire half of the transfer, so the images are shared between the two families instead
+	bool sharesSwapChainImages() const {
+		return !headless && queueTopology.graphics.family != queueTopology.present.family && !queueTopology.presentRecordsCommands;
+	}
+
+	// Record one half of the graphics to present ownership transfer of a swap chain image. Both halves name the same families and layouts;
+	// the render pass has already moved the image to PRESENT_SRC. Nothing has to be transferred back, the render pass starts from UNDEFINED and discards the old contents
+	void recordImageOwnershipBarrier(VkCommandBuffer commandBuffer, VkImage image, bool release) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.srcQueueFamilyIndex = queueTopology.graphics.family;
+		barrier.dstQueueFamilyIndex = queueTopology.present.family;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = release ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0; // the access masks of the other queue's half are ignored
+		barrier.dstAccessMask = 0; // the presentation engine needs no access mask
+
+		VkPipelineStageFlags srcStage = release ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // the acquire chains to the semaphore wait
+		vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	// The semaphores a swap chain image's present waits on, one set per image
+	void createImageSemaphores() {
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		renderFinishedSemaphores.resize(swapChainImages.size());
+		presentAcquiredSemaphores.resize(transfersImageOwnership() ? swapChainImages.size() : 0);
+		for (auto& semaphore : renderFinishedSemaphores) {
+			if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create synchronization objects for a swap chain image!");
+			}
+		}
+		for (auto& semaphore : presentAcquiredSemaphores) {
+			if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create synchronization objects for a swap chain image!");
+			}
+		}
+	}
+
+	static void destroyImageSemaphores(VkDevice device, std::vector<VkSemaphore>& renderFinished, std::vector<VkSemaphore>& presentAcquired) {
+		for (auto semaphore : renderFinished) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		for (auto semaphore : presentAcquired) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		renderFinished.clear();
+		presentAcquired.clear();
+	}
+
+	// The present queue's half of the ownership transfer only depends on the image, so it is recorded once per swap chain image and reused every frame
+	void createPresentAcquireCommands() {
+		if (!transfersImageOwnership()) {
+			return;
+		}
+
+		if (presentCommandPool == VK_NULL_HANDLE) {
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueTopology.present.family;
+
+			if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &presentCommandPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create present command pool!");
+			}
+		}
+
+		presentAcquireCommandBuffers.resize(swapChainImages.size());
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = presentCommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(presentAcquireCommandBuffers.size());
+
+		if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, presentAcquireCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate present command buffers!");
+		}
+
+		for (size_t i = 0; i < swapChainImages.size(); i++) {
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT; // resubmitted every time its image comes around, possibly before the last submission has retired
+
+			if (vkBeginCommandBuffer(presentAcquireCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("failed to begin recording command buffer!");
+			}
+
+			recordImageOwnershipBarrier(presentAcquireCommandBuffers[i], swapChainImages[i], false);
+
+			if (vkEndCommandBuffer(presentAcquireCommandBuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record command buffer!");
+			}
+		}
+	}
+
 	void createSwapChain() {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
@@ -716,14 +2734,13 @@ private:
 		 by rendering images to a different, separate image first, we would use a value like VK_IMAGE_USAGE_TRANSFER_DST_BIT instead and use a memory operation to
 		 transfer the rendered image to a swap chain image. */
 
-		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-		uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
-
-		if (indices.graphicsFamily != indices.presentFamily) {
-			// TODO: Implement ownership transfer of swap chain images if the graphics and present queues are different so that Exclusive mode can be used, which is more efficient
-			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT; // until then, use Concurrent mode
-			createInfo.queueFamilyIndexCount = 2; // must have two distinct queues for concurrent mode -- required with concurrent mode
-			createInfo.pQueueFamilyIndices = queueFamilyIndices; // which queues will be shared for concurrent mode -- required with concurrent mode
+		// Exclusive even if graphics and present are different families. Concurrent sharing can cost the driver its compression and other render target
+		// optimizations, so instead ownership of each image is handed from the graphics to the present queue every frame (see createPresentAcquireCommands). Only a present-only family, which can't take part in that, gets concurrent sharing
+		uint32_t sharingFamilies[] = { queueTopology.graphics.family, queueTopology.present.family };
+		if (sharesSwapChainImages()) {
+			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+			createInfo.queueFamilyIndexCount = 2;
+			createInfo.pQueueFamilyIndices = sharingFamilies;
 		}
 		else {
 			createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -735,17 +2752,20 @@ private:
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // specifies if the alpha channel should be used for blending with other windows in the system -- right now it is set to ignore the alpha channel
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE; // set to not care about the color of obscured pixels (like those behind another window)
-		createInfo.oldSwapchain = VK_NULL_HANDLE; // used to create a new swap chain if the old one becomes invalid (like window resizing) TODO: Implement this
+		createInfo.oldSwapchain = swapChain; // the swap chain being replaced, if any. Lets the driver reuse its resources and keep presenting the old images until the new ones are ready
 
-		if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+		VkSwapchainKHR newSwapChain;
+		if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &newSwapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
 		}
+		swapChain = newSwapChain; // the old swap chain is now retired, recreateSwapChain takes care of destroying it
 
 		vkGetSwapchainImagesKHR(logicalDevice, swapChain, &imageCount, nullptr);
 		swapChainImages.resize(imageCount);
 		vkGetSwapchainImagesKHR(logicalDevice, swapChain, &imageCount, swapChainImages.data());
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
+		swapChainPresentMode = presentMode;
 	}
 
 	void createImageViews() {
@@ -778,11 +2798,195 @@ private:
 	/*---------------------------------------------------------------------------------*/
 };
 
-int main() {
+int main(int argc, char** argv) {
 	Engine engine;
+	std::string outputPath; // headless mode writes the last rendered frame here
+	VertexFormat vertexFormat; // the compact encodings unless the command line asks otherwise
+	std::vector<std::string> cookPaths; // meshes to cook instead of running the engine
 
 	try {
+		// command line options let each deployment target pick its latency/power trade-off without a rebuild
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg == "--present-mode" && i + 1 < argc) {
+				std::string mode = argv[++i];
+				if (mode == "immediate") engine.setPresentMode(VK_PRESENT_MODE_IMMEDIATE_KHR);
+				else if (mode == "mailbox") engine.setPresentMode(VK_PRESENT_MODE_MAILBOX_KHR);
+				else if (mode == "fifo") engine.setPresentMode(VK_PRESENT_MODE_FIFO_KHR);
+				else if (mode == "fifo-relaxed") engine.setPresentMode(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+				else throw std::runtime_error("unknown present mode: " + mode);
+			}
+			else if (arg == "--fps" && i + 1 < argc) {
+				engine.setTargetFrameRate(std::stod(argv[++i]));
+			}
+			else if (arg == "--headless" && i + 1 < argc) {
+				engine.enableHeadless(std::stoull(argv[++i]));
+			}
+			else if (arg == "--output" && i + 1 < argc) {
+				outputPath = argv[++i];
+			}
+			else if (arg == "--shader-optimization" && i + 1 < argc) {
+				std::string level = argv[++i];
+				if (level == "none") engine.setShaderOptimization(ShaderOptimization::None);
+				else if (level == "performance") engine.setShaderOptimization(ShaderOptimization::Performance);
+				else if (level == "size") engine.setShaderOptimization(ShaderOptimization::Size);
+				else throw std::runtime_error("unknown shader optimization level: " + level);
+			}
+			else if (arg == "--feature" && i + 1 < argc) {
+				engine.enableShaderFeature(argv[++i]);
+			}
+			else if (arg == "--vertex-positions" && i + 1 < argc) {
+				std::string encoding = argv[++i];
+				if (encoding == "float") vertexFormat.position = PositionEncoding::Float32;
+				else if (encoding == "half") vertexFormat.position = PositionEncoding::Half;
+				else if (encoding == "snorm16") vertexFormat.position = PositionEncoding::Snorm16;
+				else throw std::runtime_error("unknown position encoding: " + encoding);
+			}
+			else if (arg == "--vertex-directions" && i + 1 < argc) {
+				std::string encoding = argv[++i];
+				if (encoding == "float") vertexFormat.direction = DirectionEncoding::Float32;
+				else if (encoding == "oct16") vertexFormat.direction = DirectionEncoding::Octahedral16;
+				else if (encoding == "oct8") vertexFormat.direction = DirectionEncoding::Octahedral8;
+				else throw std::runtime_error("unknown direction encoding: " + encoding);
+			}
+			else if (arg == "--vertex-texcoords" && i + 1 < argc) {
+				std::string encoding = argv[++i];
+				if (encoding == "float") vertexFormat.texCoord = TexCoordEncoding::Float32;
+				else if (encoding == "half") vertexFormat.texCoord = TexCoordEncoding::Half;
+				else if (encoding == "unorm16") vertexFormat.texCoord = TexCoordEncoding::Unorm16;
+				else throw std::runtime_error("unknown texture coordinate encoding: " + encoding);
+			}
+			else if (arg == "--vertex-colors" && i + 1 < argc) {
+				std::string encoding = argv[++i];
+				if (encoding == "float") vertexFormat.color = ColorEncoding::Float32;
+				else if (encoding == "unorm8") vertexFormat.color = ColorEncoding::Unorm8;
+				else throw std::runtime_error("unknown color encoding: " + encoding);
+			}
+			else if (arg == "--indices" && i + 1 < argc) {
+				std::string encoding = argv[++i];
+				if (encoding == "auto") vertexFormat.index = IndexEncoding::Automatic;
+				else if (encoding == "16") vertexFormat.index = IndexEncoding::Uint16;
+				else if (encoding == "32") vertexFormat.index = IndexEncoding::Uint32;
+				else throw std::runtime_error("unknown index encoding: " + encoding);
+			}
+			else if (arg == "--full-precision-vertices") {
+				vertexFormat = vertexFormat.fullPrecision();
+			}
+			else if (arg == "--geometry-path" && i + 1 < argc) {
+				std::string path = argv[++i];
+				if (path == "auto") engine.setGeometryPath(Engine::GeometryPath::Automatic);
+				else if (path == "indexed") engine.setGeometryPath(Engine::GeometryPath::Indexed);
+				else if (path == "cluster-culling") engine.setGeometryPath(Engine::GeometryPath::ClusterCulling);
+				else if (path == "mesh-shader") engine.setGeometryPath(Engine::GeometryPath::MeshShader);
+				else throw std::runtime_error("unknown geometry path: " + path);
+			}
+			else if (arg == "--scene" && i + 1 < argc) {
+				engine.setSceneInstanceCount(static_cast<uint32_t>(std::stoul(argv[++i])));
+			}
+			else if (arg == "--gpu-driven") {
+				engine.setGpuDrivenRendering(true);
+			}
+			else if (arg == "--bindless") {
+				engine.setBindlessResources(true);
+			}
+			else if (arg == "--mesh" && i + 1 < argc) {
+				engine.setMeshPath(argv[++i]);
+			}
+			else if (arg == "--cook" && i + 1 < argc) {
+				cookPaths.push_back(argv[++i]);
+			}
+			else if (arg == "--frames-in-flight" && i + 1 < argc) {
+				engine.setFramesInFlight(static_cast<uint32_t>(std::stoul(argv[++i])));
+			}
+			else {
+				throw std::runtime_error("unknown argument: " + arg);
+			}
+		}
+
+		engine.setVertexFormat(vertexFormat);
+
+		if (!cookPaths.empty()) { // offline cook, nothing is rendered
+			for (const auto& path : cookPaths) {
+				MeshCooker::Result cooked = engine.cookMesh(path);
+				std::cout << path << ": " << cooked.mesh.vertices.size() << " vertices, " << cooked.mesh.indices.size() / 3 << " triangles, ACMR " << cooked.before.acmr << " -> " << cooked.after.acmr
+					<< ", ATVR " << cooked.before.atvr << " -> " << cooked.after.atvr << (cooked.cached ? " (already cooked)" : "") << std::endl;
+			}
+			return EXIT_SUCCESS;
+		}
+
+		std::vector<uint8_t> lastFrame;
+		uint32_t lastWidth = 0, lastHeight = 0;
+		if (!outputPath.empty()) {
+			engine.setReadbackCallback([&](const Engine::FrameReadback& readback) {
+				lastFrame.assign(readback.pixels, readback.pixels + static_cast<size_t>(readback.rowPitch) * readback.height);
+				lastWidth = readback.width;
+				lastHeight = readback.height;
+			});
+		}
+
 		engine.run();
+
+		if (!outputPath.empty() && !lastFrame.empty()) { // binary PPM, RGB without the alpha channel
+			std::ofstream file(outputPath, std::ios::binary);
+			file << "P6\n" << lastWidth << " " << lastHeight << "\n255\n";
+			for (size_t pixel = 0; pixel < static_cast<size_t>(lastWidth) * lastHeight; pixel++) {
+				file.write(reinterpret_cast<const char*>(&lastFrame[pixel * 4]), 3);
+			}
+		}
+
+		const auto& stats = engine.getFrameStats();
+		std::cout << "frames submitted: " << stats.framesSubmitted << ", fence waits: " << stats.fenceWaits << " (" << stats.fenceWaitMilliseconds << " ms)"
+			<< ", CPU draw calls per frame: " << (stats.framesSubmitted > 0 ? static_cast<double>(stats.drawCalls) / stats.framesSubmitted : 0.0) << std::endl;
+		std::cout << "pipelines: " << engine.getPipelineRegistry().size() << " unique, " << engine.getPipelineRegistry().getHitCount() << " registry hits, " << engine.getPipelineRegistry().getMissCount() << " misses" << std::endl;
+		const auto& queues = engine.getQueueTopology();
+		std::cout << "queues (family.index): graphics " << queues.graphics.family << "." << queues.graphics.index << ", present " << queues.present.family << "." << queues.present.index
+			<< ", compute " << queues.compute.family << "." << queues.compute.index << (queues.hasDedicatedCompute() ? " (dedicated)" : "")
+			<< ", transfer " << queues.transfer.family << "." << queues.transfer.index << (queues.hasDedicatedTransfer() ? " (dedicated)" : "") << std::endl;
+
+		const auto& meshStats = engine.getMeshStats();
+		std::cout << "mesh: " << meshStats.vertexCount << " vertices at " << meshStats.vertexStride << " bytes (" << meshStats.fullPrecisionStride << " at full precision), "
+			<< meshStats.indexCount << " " << meshStats.indexSize * 8 << "-bit indices, "
+			<< (static_cast<uint64_t>(meshStats.vertexCount) * meshStats.vertexStride + static_cast<uint64_t>(meshStats.indexCount) * meshStats.indexSize) / 1024 << " KiB ("
+			<< (static_cast<uint64_t>(meshStats.vertexCount) * meshStats.fullPrecisionStride + static_cast<uint64_t>(meshStats.indexCount) * 4) / 1024 << " KiB at full precision)" << std::endl;
+		std::cout << "mesh vertex cache (" << MeshOptimizer::simulatedCacheSize << " entry FIFO): ACMR " << meshStats.sourceCache.acmr << " -> " << meshStats.cookedCache.acmr
+			<< ", ATVR " << meshStats.sourceCache.atvr << " -> " << meshStats.cookedCache.atvr << (meshStats.cookedEarlier ? ", cooked earlier" : ", cooked at startup") << std::endl;
+		Engine::GeometryPath geometryPath = engine.getGeometryPath();
+		std::cout << "geometry path: " << (geometryPath == Engine::GeometryPath::MeshShader ? "mesh shader" : geometryPath == Engine::GeometryPath::ClusterCulling ? "compute cluster culling" : "indexed");
+		if (meshStats.meshletCount > 0) {
+			std::cout << ", " << meshStats.meshletCount << " meshlets of up to " << Meshlet::maxVertices << " vertices and " << Meshlet::maxTriangles << " triangles";
+		}
+		std::cout << std::endl;
+		if (meshStats.instanceCount > 0) {
+			std::cout << "scene: " << meshStats.instanceCount << " instances, " << (engine.usesGpuDrivenRendering() ? "frustum and occlusion culled on the GPU, drawn with an indirect count draw per phase" : "culled and drawn by the CPU") << std::endl;
+			if (engine.usesBindlessResources()) {
+				const auto& table = engine.getBindlessTable();
+				std::cout << "bindless table: " << table.getBufferCount() << "/" << table.getBufferCapacity() << " buffers, " << table.getTextureCount() << "/" << table.getTextureCapacity() << " textures" << std::endl;
+			}
+		}
+		const auto& descriptors = engine.getDescriptorStats();
+		std::cout << "descriptors: " << descriptors.transientSets << " per-frame set(s) from " << descriptors.poolCount << " pool(s) reset " << descriptors.poolResets << " time(s), "
+			<< descriptors.cachedSets << " cached set(s) reused " << descriptors.cacheHits << " time(s)" << std::endl;
+		const auto& uniforms = engine.getUniformStats();
+		std::cout << "uniform ring: " << uniforms.slicesAllocated << " slice(s), at most " << uniforms.peakFrameBytes << " of " << uniforms.bytesPerFrame << " bytes per frame" << std::endl;
+		const auto& uploads = engine.getUploadStats();
+		std::cout << "uploads: " << uploads.bytesUploaded / 1024 << " KiB in " << uploads.batchesSubmitted << " batch(es) on the " << (uploads.dedicatedQueue ? "dedicated transfer" : "graphics")
+			<< " queue, " << uploads.ringStalls << " staging ring stall(s)" << std::endl;
+
+		const auto& heaps = engine.getMemoryStats();
+		for (size_t i = 0; i < heaps.size(); i++) {
+			if (heaps[i].blockCount == 0) {
+				continue;
+			}
+			std::cout << "memory heap " << i << (heaps[i].deviceLocal ? " (device local)" : " (host)") << ": " << heaps[i].usedBytes / 1024 << " KiB used by " << heaps[i].allocationCount << " allocation(s) in "
+				<< heaps[i].blockCount << " block(s) of " << heaps[i].reservedBytes / 1024 << " KiB, fragmentation " << heaps[i].fragmentation << std::endl;
+		}
+		std::cout << "average CPU time in submit and present calls: " << engine.getFramePacer().getAverageQueueCallMilliseconds() << " ms, average frame interval: " << engine.getFramePacer().getAverageFrameIntervalMilliseconds() << " ms" << std::endl;
+		const LatencyMonitor& latency = engine.getLatencyMonitor();
+		std::cout << "average latency from submit to GPU completion: " << latency.getAverageGpuLatencyMilliseconds() << " ms";
+		if (latency.hasDisplayTiming()) {
+			std::cout << ", to the display: " << latency.getAverageDisplayLatencyMilliseconds() << " ms";
+		}
+		std::cout << std::endl;
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "../headers/bindless_table.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+bool BindlessTable::isSupported(VkPhysicalDevice physicalDevice) {
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return vulkan12Features.runtimeDescriptorArray && vulkan12Features.descriptorBindingPartiallyBound && vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind && vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind &&
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing && vulkan12Features.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+void BindlessTable::enableFeatures(VkPhysicalDeviceVulkan12Features& features) {
+	features.runtimeDescriptorArray = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+	features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+}
+
+BindlessTable::BindlessTable(VkDevice& logicalDevice, VkPhysicalDevice physicalDevice, uint32_t maxTextures, uint32_t maxBuffers) {
+	this->logicalDevice = logicalDevice;
+
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+	vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &vulkan12Properties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	// every stage can see the whole table, so the per-stage limits apply as well as the per-set ones
+	textureCapacity = std::min({ maxTextures, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages, vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers });
+	bufferCapacity = std::min({ maxBuffers, vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+	uint32_t resourceLimit = vulkan12Properties.maxPerStageUpdateAfterBindResources;
+	if (textureCapacity + bufferCapacity > resourceLimit) {
+		textureCapacity = std::min(textureCapacity, resourceLimit / 2);
+		bufferCapacity = std::min(bufferCapacity, resourceLimit - textureCapacity);
+	}
+
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	bindings[0].binding = textureBinding;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = textureCapacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[1].binding = bufferBinding;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = bufferCapacity;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// slots that were never written may not be read but don't have to be valid, and written slots can change while the set is bound
+	VkDescriptorBindingFlags bindingFlags[2] = {};
+	for (auto& flags : bindingFlags) {
+		flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = 2;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSizes[] = { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity } };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &set) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set!");
+	}
+}
+
+uint32_t BindlessTable::allocateSlot(uint32_t& highWater, std::vector<uint32_t>& freeSlots, uint32_t capacity) {
+	if (!freeSlots.empty()) {
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+	if (highWater == capacity) {
+		throw std::runtime_error("bindless table is full!");
+	}
+	return highWater++;
+}
+
+uint32_t BindlessTable::addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout) {
+	uint32_t index = allocateSlot(textureHighWater, freeTextures, textureCapacity);
+
+	VkDescriptorImageInfo imageInfo{ sampler, imageView, imageLayout };
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = textureBinding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+
+	return index;
+}
+
+uint32_t BindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	uint32_t index = allocateSlot(bufferHighWater, freeBuffers, bufferCapacity);
+
+	VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = bufferBinding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+
+	return index;
+}
+
+void BindlessTable::releaseTexture(uint32_t index) {
+	freeTextures.push_back(index);
+}
+
+void BindlessTable::releaseBuffer(uint32_t index) {
+	freeBuffers.push_back(index);
+}
+
+VkDescriptorSetLayout BindlessTable::getSetLayout() const {
+	return setLayout;
+}
+
+VkDescriptorSet BindlessTable::getSet() const {
+	return set;
+}
+
+std::vector<VkDescriptorType> BindlessTable::bindingTypes() {
+	return { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+}
+
+uint32_t BindlessTable::getTextureCount() const {
+	return textureHighWater - static_cast<uint32_t>(freeTextures.size());
+}
+
+uint32_t BindlessTable::getBufferCount() const {
+	return bufferHighWater - static_cast<uint32_t>(freeBuffers.size());
+}
+
+uint32_t BindlessTable::getTextureCapacity() const {
+	return textureCapacity;
+}
+
+uint32_t BindlessTable::getBufferCapacity() const {
+	return bufferCapacity;
+}
+
+void BindlessTable::destroy() {
+	if (descriptorPool != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr); // also frees the set
+		descriptorPool = VK_NULL_HANDLE;
+	}
+	if (setLayout != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(logicalDevice, setLayout, nullptr);
+		setLayout = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../headers/deletion_queue.h"
+
+
+void DeletionQueue::retire(uint64_t retireFrame, std::function<void()> destroy) {
+	pending.push_back({ retireFrame, std::move(destroy) });
+}
+
+void DeletionQueue::collect(uint64_t completedFrames) {
+	while (!pending.empty() && pending.front().retireFrame <= completedFrames) {
+		pending.front().destroy();
+		pending.pop_front();
+	}
+}
+
+void DeletionQueue::flush() {
+	for (auto& deletion : pending) {
+		deletion.destroy();
+	}
+	pending.clear();
+}
+
+size_t DeletionQueue::size() const {
+	return pending.size();
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "../headers/descriptor_allocator.h"
+#include "../headers/hash.h"
+#include <algorithm>
+#include <stdexcept>
+
+// Descriptors per set each pool is sized for, by type. Generous for what the engine's shaders declare, a pool that runs out is simply followed by another
+static const std::pair<VkDescriptorType, uint32_t> poolRatios[] = {
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 },
+	{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+};
+
+
+DescriptorResource DescriptorResource::storageBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	DescriptorResource resource{ binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	resource.buffer = { buffer, offset, range };
+	return resource;
+}
+
+DescriptorResource DescriptorResource::dynamicUniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize range) {
+	DescriptorResource resource{ binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC };
+	resource.buffer = { buffer, 0, range };
+	return resource;
+}
+
+DescriptorResource DescriptorResource::combinedImageSampler(uint32_t binding, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout) {
+	DescriptorResource resource{ binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+	resource.image = { sampler, imageView, imageLayout };
+	return resource;
+}
+
+DescriptorResource DescriptorResource::storageImage(uint32_t binding, VkImageView imageView, VkImageLayout imageLayout) {
+	DescriptorResource resource{ binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE };
+	resource.image = { VK_NULL_HANDLE, imageView, imageLayout };
+	return resource;
+}
+
+bool DescriptorResource::operator==(const DescriptorResource& other) const {
+	return binding == other.binding && type == other.type &&
+		buffer.buffer == other.buffer.buffer && buffer.offset == other.buffer.offset && buffer.range == other.buffer.range &&
+		image.sampler == other.image.sampler && image.imageView == other.image.imageView && image.imageLayout == other.image.imageLayout;
+}
+
+
+DescriptorAllocator::DescriptorAllocator(VkDevice& logicalDevice, uint32_t framesInFlight) {
+	this->logicalDevice = logicalDevice;
+	frames.resize(framesInFlight);
+}
+
+VkDescriptorPool DescriptorAllocator::acquirePool() {
+	if (!freePools.empty()) {
+		VkDescriptorPool pool = freePools.back();
+		freePools.pop_back();
+		return pool;
+	}
+
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const auto& ratio : poolRatios) {
+		poolSizes.push_back({ ratio.first, ratio.second * nextPoolSets });
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = 0; // no FREE_DESCRIPTOR_SET_BIT, sets are only ever released by resetting the whole pool
+	poolInfo.maxSets = nextPoolSets;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	nextPoolSets = std::min(nextPoolSets * 2, maxPoolSets);
+	stats.poolCount++;
+	return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(PoolChain& chain, VkDescriptorSetLayout setLayout) {
+	if (chain.pools.empty()) {
+		chain.pools.push_back(acquirePool());
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = chain.pools.back();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	VkDescriptorSet set;
+	VkResult result = vkAllocateDescriptorSets(logicalDevice, &allocInfo, &set);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) { // the pool is full, carry on in another one
+		chain.pools.push_back(acquirePool());
+		allocInfo.descriptorPool = chain.pools.back();
+		result = vkAllocateDescriptorSets(logicalDevice, &allocInfo, &set);
+	}
+
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor set!");
+	}
+	return set;
+}
+
+void DescriptorAllocator::write(VkDescriptorSet set, const std::vector<DescriptorResource>& resources) {
+	std::vector<VkWriteDescriptorSet> writes(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		const DescriptorResource& resource = resources[i];
+		bool isImage = resource.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || resource.type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+			resource.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || resource.type == VK_DESCRIPTOR_TYPE_SAMPLER;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = resource.binding;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = resource.type;
+		writes[i].pImageInfo = isImage ? &resource.image : nullptr;
+		writes[i].pBufferInfo = isImage ? nullptr : &resource.buffer;
+	}
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frame) {
+	PoolChain& chain = frames[frame];
+	for (auto pool : chain.pools) {
+		vkResetDescriptorPool(logicalDevice, pool, 0);
+		freePools.push_back(pool);
+		stats.poolResets++;
+	}
+	chain.pools.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::allocateTransient(uint32_t frame, VkDescriptorSetLayout setLayout, const std::vector<DescriptorResource>& resources) {
+	VkDescriptorSet set = allocate(frames[frame], setLayout);
+	write(set, resources);
+	stats.transientSets++;
+	return set;
+}
+
+VkDescriptorSet DescriptorAllocator::getPersistent(VkDescriptorSetLayout setLayout, const std::vector<DescriptorResource>& resources) {
+	// hash the structs field by field, they can contain padding
+	uint64_t key = Hash::combine(Hash::offsetBasis, setLayout);
+	for (const auto& resource : resources) {
+		key = Hash::combine(key, resource.binding);
+		key = Hash::combine(key, resource.type);
+		key = Hash::combine(key, resource.buffer.buffer);
+		key = Hash::combine(key, resource.buffer.offset);
+		key = Hash::combine(key, resource.buffer.range);
+		key = Hash::combine(key, resource.image.sampler);
+		key = Hash::combine(key, resource.image.imageView);
+		key = Hash::combine(key, resource.image.imageLayout);
+	}
+
+	std::vector<CachedSet>& cached = cachedSets[key];
+	for (const auto& entry : cached) {
+		if (entry.setLayout == setLayout && entry.resources == resources) {
+			stats.cacheHits++;
+			return entry.set;
+		}
+	}
+
+	VkDescriptorSet set = allocate(persistent, setLayout);
+	write(set, resources);
+	cached.push_back({ setLayout, resources, set });
+	stats.cachedSets++;
+	return set;
+}
+
+const DescriptorAllocator::Stats& DescriptorAllocator::getStats() const {
+	return stats;
+}
+
+void DescriptorAllocator::destroy() {
+	for (auto& frame : frames) {
+		freePools.insert(freePools.end(), frame.pools.begin(), frame.pools.end());
+		frame.pools.clear();
+	}
+	freePools.insert(freePools.end(), persistent.pools.begin(), persistent.pools.end());
+	persistent.pools.clear();
+
+	for (auto pool : freePools) {
+		vkDestroyDescriptorPool(logicalDevice, pool, nullptr); // also frees the sets allocated from it
+	}
+	freePools.clear();
+	cachedSets.clear();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../headers/frame_pacer.h"
+#include <thread>
+
+
+void FramePacer::setTargetFrameRate(double framesPerSecond) {
+	if (framesPerSecond <= 0.0) {
+		targetFrameTime = Clock::duration::zero();
+		return;
+	}
+
+	targetFrameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+	nextFrameDeadline = Clock::now(); // start pacing from now instead of trying to catch up on frames from before the limit was set
+}
+
+double FramePacer::getTargetFrameRate() const {
+	if (targetFrameTime == Clock::duration::zero()) {
+		return 0.0;
+	}
+	return 1.0 / std::chrono::duration<double>(targetFrameTime).count();
+}
+
+void FramePacer::waitForNextFrame() {
+	Clock::time_point now = Clock::now();
+
+	if (targetFrameTime != Clock::duration::zero()) {
+		const auto spinThreshold = std::chrono::milliseconds(1); // OS sleeps can overshoot by about a millisecond, so spin for the remainder
+
+		if (nextFrameDeadline - now > spinThreshold) {
+			std::this_thread::sleep_until(nextFrameDeadline - spinThreshold);
+		}
+		while (Clock::now() < nextFrameDeadline) {
+			std::this_thread::yield();
+		}
+
+		now = Clock::now();
+
+		// if we fell more than a frame behind (a hitch or a debugger break) don't rush out frames to catch up, just start pacing again from now
+		if (now - nextFrameDeadline > targetFrameTime) {
+			nextFrameDeadline = now;
+		}
+		nextFrameDeadline += targetFrameTime;
+	}
+
+	if (hasLastFrame) {
+		double intervalMs = std::chrono::duration<double, std::milli>(now - lastFrameStart).count();
+		averageFrameIntervalMs = hasFrameIntervalSample ? averageFrameIntervalMs + (intervalMs - averageFrameIntervalMs) * smoothing : intervalMs;
+		hasFrameIntervalSample = true;
+	}
+	lastFrameStart = now;
+	hasLastFrame = true;
+}
+
+void FramePacer::markSubmit() {
+	submitTime = Clock::now();
+}
+
+void FramePacer::markPresent() {
+	lastQueueCallMs = std::chrono::duration<double, std::milli>(Clock::now() - submitTime).count();
+	averageQueueCallMs = hasQueueCallSample ? averageQueueCallMs + (lastQueueCallMs - averageQueueCallMs) * smoothing : lastQueueCallMs;
+	hasQueueCallSample = true;
+}
+
+double FramePacer::getLastQueueCallMilliseconds() const {
+	return lastQueueCallMs;
+}
+
+double FramePacer::getAverageQueueCallMilliseconds() const {
+	return averageQueueCallMs;
+}
+
+double FramePacer::getAverageFrameIntervalMilliseconds() const {
+	return averageFrameIntervalMs;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "../headers/gpu_allocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+// Rank of size / minAllocationSize rounded up to a power of two
+static uint32_t orderFor(VkDeviceSize size, VkDeviceSize minSize) {
+	uint32_t order = 0;
+	while ((minSize << order) < size) {
+		order++;
+	}
+	return order;
+}
+
+
+GpuAllocator::GpuAllocator(VkDevice& logicalDevice, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize) {
+	this->logicalDevice = logicalDevice;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	nonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
+
+	this->blockSize = minAllocationSize << orderFor(blockSize, minAllocationSize);
+}
+
+uint32_t GpuAllocator::findMemoryType(uint32_t typeFilter, MemoryUsage usage) const {
+	struct Candidate {
+		VkMemoryPropertyFlags required;
+		VkMemoryPropertyFlags excluded;
+	};
+
+	// most to least preferred, the first that some allowed memory type satisfies wins
+	std::vector<Candidate> candidates;
+	switch (usage) {
+	case MemoryUsage::GpuOnly: // keep host visible device memory (the small BAR heap on discrete GPUs) for things the CPU writes
+		candidates = { { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT }, { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 }, { 0, 0 } };
+		break;
+	case MemoryUsage::Upload: // write combined memory is fastest for sequential CPU writes, cached memory only helps reads
+		candidates = { { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT },
+			{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 }, { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0 } };
+		break;
+	case MemoryUsage::Readback: // uncached reads from the CPU are extremely slow
+		candidates = { { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0 },
+			{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 }, { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0 } };
+		break;
+	}
+
+	for (const auto& candidate : candidates) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+			if ((typeFilter & (1 << i)) && (flags & candidate.required) == candidate.required && (flags & candidate.excluded) == 0) {
+				return i;
+			}
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+uint32_t GpuAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	Block block{};
+	if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+
+	block.size = size;
+	block.memoryType = memoryType;
+	block.linear = linear;
+	block.dedicated = dedicated;
+
+	// host visible memory stays mapped for the lifetime of the block, mapping per access is expensive and the pointer can be handed out directly
+	if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(logicalDevice, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped) != VK_SUCCESS) {
+			vkFreeMemory(logicalDevice, block.memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+
+	if (!dedicated) {
+		block.freeLists.resize(orderFor(size, minAllocationSize) + 1);
+		block.freeLists.back().insert(0); // the whole block is one free range of the highest order
+	}
+
+	// reuse the slot of a block that was freed
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		if (blocks[i].memory == VK_NULL_HANDLE) {
+			blocks[i] = std::move(block);
+			return i;
+		}
+	}
+	blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+bool GpuAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& order) {
+	// buddy ranges are aligned to their own size, so a range at least as large as the alignment is always aligned
+	order = orderFor(std::max({ size, alignment, minAllocationSize }), minAllocationSize);
+	if (order >= block.freeLists.size()) {
+		return false;
+	}
+
+	uint32_t available = order;
+	while (available < block.freeLists.size() && block.freeLists[available].empty()) {
+		available++;
+	}
+	if (available == block.freeLists.size()) {
+		return false;
+	}
+
+	offset = *block.freeLists[available].begin(); // lowest offset first keeps the used ranges packed at the start of the block
+	block.freeLists[available].erase(block.freeLists[available].begin());
+
+	// split until the range is the requested size, the upper halves go back on the free lists
+	while (available > order) {
+		available--;
+		block.freeLists[available].insert(offset + (minAllocationSize << available));
+	}
+
+	return true;
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, usage);
+
+	GpuAllocation allocation{};
+	allocation.size = requirements.size;
+	allocation.memoryType = memoryType;
+	allocation.coherent = (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	if (requirements.size > blockSize / 2) { // would waste most of a block, give it memory of its own
+		allocation.blockIndex = createBlock(memoryType, requirements.size, linear, true);
+		allocation.offset = 0;
+	}
+	else {
+		bool found = false;
+		for (uint32_t i = 0; i < blocks.size() && !found; i++) {
+			Block& block = blocks[i];
+			if (block.memory == VK_NULL_HANDLE || block.dedicated || block.memoryType != memoryType || block.linear != linear) {
+				continue;
+			}
+			if (allocateFromBlock(block, requirements.size, requirements.alignment, allocation.offset, allocation.order)) {
+				allocation.blockIndex = i;
+				found = true;
+			}
+		}
+
+		if (!found) {
+			allocation.blockIndex = createBlock(memoryType, blockSize, linear, false);
+			if (!allocateFromBlock(blocks[allocation.blockIndex], requirements.size, requirements.alignment, allocation.offset, allocation.order)) {
+				throw std::runtime_error("failed to sub-allocate device memory!");
+			}
+		}
+	}
+
+	Block& block = blocks[allocation.blockIndex];
+	block.usedBytes += block.dedicated ? block.size : minAllocationSize << allocation.order;
+	block.requestedBytes += requirements.size;
+	block.allocationCount++;
+
+	allocation.memory = block.memory;
+	allocation.mapped = block.mapped ? static_cast<uint8_t*>(block.mapped) + allocation.offset : nullptr;
+	return allocation;
+}
+
+GpuAllocation GpuAllocator::allocateBuffer(VkBuffer buffer, MemoryUsage usage) {
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(logicalDevice, buffer, &requirements);
+
+	GpuAllocation allocation = allocate(requirements, usage, true);
+	if (vkBindBufferMemory(logicalDevice, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		free(allocation);
+		throw std::runtime_error("failed to bind buffer memory!");
+	}
+	return allocation;
+}
+
+GpuAllocation GpuAllocator::allocateImage(VkImage image, MemoryUsage usage, bool optimalTiling) {
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(logicalDevice, image, &requirements);
+
+	GpuAllocation allocation = allocate(requirements, usage, !optimalTiling);
+	if (vkBindImageMemory(logicalDevice, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		free(allocation);
+		throw std::runtime_error("failed to bind image memory!");
+	}
+	return allocation;
+}
+
+void GpuAllocator::free(GpuAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Block& block = blocks[allocation.blockIndex];
+	block.requestedBytes -= allocation.size;
+	block.allocationCount--;
+
+	if (block.dedicated) {
+		freeBlock(block);
+		allocation = GpuAllocation{};
+		return;
+	}
+
+	block.usedBytes -= minAllocationSize << allocation.order;
+
+	// merge with the buddy for as long as it is free too
+	VkDeviceSize offset = allocation.offset;
+	uint32_t order = allocation.order;
+	while (order + 1 < block.freeLists.size()) {
+		VkDeviceSize buddy = offset ^ (minAllocationSize << order);
+		auto buddyRange = block.freeLists[order].find(buddy);
+		if (buddyRange == block.freeLists[order].end()) {
+			break;
+		}
+		block.freeLists[order].erase(buddyRange);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+	block.freeLists[order].insert(offset);
+
+	// keep one empty block of each kind around so allocating and freeing in a loop doesn't hit vkAllocateMemory every time
+	if (block.allocationCount == 0) {
+		for (auto& other : blocks) {
+			if (&other != &block && other.memory != VK_NULL_HANDLE && !other.dedicated && other.allocationCount == 0 && other.memoryType == block.memoryType && other.linear == block.linear) {
+				freeBlock(block);
+				break;
+			}
+		}
+	}
+
+	allocation = GpuAllocation{};
+}
+
+void GpuAllocator::freeBlock(Block& block) {
+	vkFreeMemory(logicalDevice, block.memory, nullptr); // freeing mapped memory implicitly unmaps it
+	block = Block{};
+}
+
+VkMappedMemoryRange GpuAllocator::alignedRange(const GpuAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const {
+	// the range has to be aligned to nonCoherentAtomSize, or end at the end of the memory
+	VkDeviceSize start = allocation.offset + offset;
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : start + size;
+	VkDeviceSize blockEnd = blocks[allocation.blockIndex].size;
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = start / nonCoherentAtomSize * nonCoherentAtomSize;
+	range.size = std::min((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, blockEnd) - range.offset;
+	return range;
+}
+
+void GpuAllocator::flush(const GpuAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (allocation.coherent || allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	VkMappedMemoryRange range = alignedRange(allocation, offset, size);
+	vkFlushMappedMemoryRanges(logicalDevice, 1, &range);
+}
+
+void GpuAllocator::invalidate(const GpuAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (allocation.coherent || allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	VkMappedMemoryRange range = alignedRange(allocation, offset, size);
+	vkInvalidateMappedMemoryRanges(logicalDevice, 1, &range);
+}
+
+std::vector<GpuAllocator::HeapStats> GpuAllocator::getHeapStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<HeapStats> stats(memoryProperties.memoryHeapCount);
+	std::vector<VkDeviceSize> freeBytes(memoryProperties.memoryHeapCount, 0);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		stats[i].heapSize = memoryProperties.memoryHeaps[i].size;
+		stats[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+
+	for (const auto& block : blocks) {
+		if (block.memory == VK_NULL_HANDLE) {
+			continue;
+		}
+
+		HeapStats& heap = stats[memoryProperties.memoryTypes[block.memoryType].heapIndex];
+		heap.blockCount++;
+		heap.allocationCount += block.allocationCount;
+		heap.reservedBytes += block.size;
+		heap.usedBytes += block.usedBytes;
+		heap.requestedBytes += block.requestedBytes;
+
+		for (uint32_t order = static_cast<uint32_t>(block.freeLists.size()); order > 0; order--) {
+			if (!block.freeLists[order - 1].empty()) {
+				heap.largestFreeRange = std::max(heap.largestFreeRange, minAllocationSize << (order - 1));
+				break;
+			}
+		}
+		freeBytes[memoryProperties.memoryTypes[block.memoryType].heapIndex] += block.size - block.usedBytes;
+	}
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		if (freeBytes[i] > 0) {
+			stats[i].fragmentation = 1.0 - static_cast<double>(stats[i].largestFreeRange) / static_cast<double>(freeBytes[i]);
+		}
+	}
+
+	return stats;
+}
+
+void GpuAllocator::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto& block : blocks) {
+		if (block.memory != VK_NULL_HANDLE) {
+			freeBlock(block);
+		}
+	}
+	blocks.clear();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "../headers/latency_monitor.h"
+#include <vector>
+
+
+void LatencyMonitor::Average::add(double value) {
+	last = value;
+	average = samples == 0 ? value : average + (value - average) * smoothing;
+	samples++;
+}
+
+
+LatencyMonitor::LatencyMonitor(VkDevice& logicalDevice) {
+	this->logicalDevice = logicalDevice;
+	waitThread = std::thread(&LatencyMonitor::waitLoop, this);
+}
+
+LatencyMonitor::~LatencyMonitor() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	submitted.notify_all();
+	if (waitThread.joinable()) {
+		waitThread.join();
+	}
+}
+
+void LatencyMonitor::waitLoop() {
+	while (true) {
+		Submission submission;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			submitted.wait(lock, [this]() { return stopping || !submissions.empty(); });
+			if (submissions.empty()) {
+				return; // stopping, and every fence has been waited for
+			}
+			submission = submissions.front();
+		}
+
+		// fences signal in submission order on the one graphics queue, so waiting on them one after the other loses nothing
+		vkWaitForFences(logicalDevice, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+		Clock::time_point completed = Clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			gpuLatency.add(std::chrono::duration<double, std::milli>(completed - submission.submitTime).count());
+			submissions.pop_front();
+			ticketsFinished++;
+		}
+		finished.notify_all();
+	}
+}
+
+uint64_t LatencyMonitor::track(VkFence fence, Clock::time_point submitTime) {
+	uint64_t ticket;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		submissions.push_back({ fence, submitTime });
+		ticket = ++ticketsIssued;
+	}
+	submitted.notify_one();
+	return ticket;
+}
+
+void LatencyMonitor::release(uint64_t ticket) {
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this, ticket]() { return ticketsFinished >= ticket; });
+}
+
+void LatencyMonitor::waitIdle() {
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this]() { return ticketsFinished == ticketsIssued; });
+}
+
+void LatencyMonitor::enableDisplayTiming() {
+	getPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(vkGetDeviceProcAddr(logicalDevice, "vkGetPastPresentationTimingGOOGLE"));
+}
+
+bool LatencyMonitor::hasDisplayTiming() const {
+	return getPastPresentationTiming != nullptr;
+}
+
+void LatencyMonitor::trackPresent(uint32_t presentId, Clock::time_point submitTime) {
+	pendingPresents[presentId] = submitTime;
+	while (pendingPresents.size() > maxPendingPresents) {
+		pendingPresents.erase(pendingPresents.begin());
+	}
+}
+
+void LatencyMonitor::collectPresentTimes(VkSwapchainKHR swapChain) {
+	if (getPastPresentationTiming == nullptr || pendingPresents.empty()) {
+		return;
+	}
+
+	uint32_t timingCount = 0;
+	if (getPastPresentationTiming(logicalDevice, swapChain, &timingCount, nullptr) != VK_SUCCESS || timingCount == 0) {
+		return;
+	}
+	std::vector<VkPastPresentationTimingGOOGLE> timings(timingCount);
+	if (getPastPresentationTiming(logicalDevice, swapChain, &timingCount, timings.data()) != VK_SUCCESS && timingCount == 0) {
+		return;
+	}
+	timings.resize(timingCount);
+
+	for (const auto& timing : timings) {
+		auto pending = pendingPresents.find(timing.presentID);
+		if (pending == pendingPresents.end()) {
+			continue;
+		}
+		Clock::time_point displayed{ std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(timing.actualPresentTime)) };
+		displayLatency.add(std::chrono::duration<double, std::milli>(displayed - pending->second).count());
+		pendingPresents.erase(pending);
+	}
+}
+
+void LatencyMonitor::forgetPresents() {
+	pendingPresents.clear();
+}
+
+double LatencyMonitor::getAverageGpuLatencyMilliseconds() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return gpuLatency.average;
+}
+
+double LatencyMonitor::getAverageDisplayLatencyMilliseconds() const {
+	return displayLatency.average;
+}
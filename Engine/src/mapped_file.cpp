@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../headers/mapped_file.h"
+#include <stdexcept>
+
+#ifdef PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef PLATFORM_WINDOWS
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("failed to open file: " + filename);
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		close();
+		throw std::runtime_error("failed to get file size: " + filename);
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	if (size == 0) {
+		return; // empty files can't be mapped, there's nothing to read anyway
+	}
+
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr) {
+		close();
+		throw std::runtime_error("failed to map file: " + filename);
+	}
+
+	data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		close();
+		throw std::runtime_error("failed to map file: " + filename);
+	}
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw std::runtime_error("failed to open file: " + filename);
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0) {
+		::close(file);
+		throw std::runtime_error("failed to get file size: " + filename);
+	}
+	size = static_cast<size_t>(fileStat.st_size);
+
+	if (size > 0) {
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping == MAP_FAILED) {
+			::close(file);
+			throw std::runtime_error("failed to map file: " + filename);
+		}
+		data = mapping;
+	}
+
+	::close(file); // the mapping keeps its own reference to the file
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+void MappedFile::close() {
+#ifdef PLATFORM_WINDOWS
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr) {
+		CloseHandle(fileHandle);
+	}
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (data != nullptr) {
+		munmap(const_cast<void*>(data), size);
+	}
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+const void* MappedFile::getData() const {
+	return data;
+}
+
+size_t MappedFile::getSize() const {
+	return size;
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include "../headers/mesh.h"
+#include "../headers/hash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <glm/gtc/packing.hpp>
+
+// Fold a unit vector onto the octahedron |x| + |y| + |z| = 1 and unfold the lower half over the corners of the square, which maps every direction into [-1, 1]^2
+static glm::vec2 octahedralEncode(glm::vec3 direction) {
+	direction /= std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	glm::vec2 encoded(direction.x, direction.y);
+	if (direction.z < 0.0f) {
+		glm::vec2 sign(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+	}
+	return encoded;
+}
+
+// Store the first components of value in one of the vertex formats VertexFormat uses
+static void writeAttribute(uint8_t* destination, VkFormat format, const glm::vec4& value) {
+	switch (format) {
+	case VK_FORMAT_R32G32_SFLOAT: case VK_FORMAT_R32G32B32_SFLOAT: case VK_FORMAT_R32G32B32A32_SFLOAT: {
+		uint32_t count = format == VK_FORMAT_R32G32_SFLOAT ? 2 : format == VK_FORMAT_R32G32B32_SFLOAT ? 3 : 4;
+		std::memcpy(destination, &value[0], count * sizeof(float));
+		break;
+	}
+	case VK_FORMAT_R16G16_SFLOAT: case VK_FORMAT_R16G16B16A16_SFLOAT:
+		for (int i = 0; i < (format == VK_FORMAT_R16G16_SFLOAT ? 2 : 4); i++) {
+			uint16_t half = glm::packHalf1x16(value[i]);
+			std::memcpy(destination + i * 2, &half, 2);
+		}
+		break;
+	case VK_FORMAT_R16G16_SNORM: case VK_FORMAT_R16G16B16A16_SNORM:
+		for (int i = 0; i < (format == VK_FORMAT_R16G16_SNORM ? 2 : 4); i++) {
+			uint16_t snorm = glm::packSnorm1x16(value[i]);
+			std::memcpy(destination + i * 2, &snorm, 2);
+		}
+		break;
+	case VK_FORMAT_R16G16_UNORM:
+		for (int i = 0; i < 2; i++) {
+			uint16_t unorm = glm::packUnorm1x16(value[i]);
+			std::memcpy(destination + i * 2, &unorm, 2);
+		}
+		break;
+	case VK_FORMAT_R8G8_SNORM: case VK_FORMAT_R8G8B8A8_SNORM:
+		for (int i = 0; i < (format == VK_FORMAT_R8G8_SNORM ? 2 : 4); i++) {
+			destination[i] = glm::packSnorm1x8(value[i]);
+		}
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		for (int i = 0; i < 4; i++) {
+			destination[i] = glm::packUnorm1x8(value[i]);
+		}
+		break;
+	default:
+		throw std::runtime_error("unsupported vertex format!");
+	}
+}
+
+
+MeshData MeshData::makeSphere(uint32_t rings, uint32_t segments) {
+	if (rings < 2 || segments < 3) {
+		throw std::runtime_error("a sphere needs at least 2 rings and 3 segments!");
+	}
+
+	const float pi = 3.14159265358979f;
+
+	MeshData mesh;
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		float theta = pi * ring / rings; // from the top pole down
+		for (uint32_t segment = 0; segment <= segments; segment++) {
+			float phi = 2.0f * pi * segment / segments;
+
+			MeshVertex vertex{};
+			vertex.normal = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			vertex.position = vertex.normal;
+			vertex.tangent = glm::vec4(-std::sin(phi), 0.0f, std::cos(phi), 1.0f); // along increasing u
+			vertex.texCoord = glm::vec2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings);
+			vertex.color = glm::vec4(vertex.normal * 0.5f + 0.5f, 1.0f);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			uint32_t a = ring * (segments + 1) + segment;
+			uint32_t b = a + segments + 1; // below a
+			uint32_t c = b + 1;
+			uint32_t d = a + 1; // next to a
+
+			// the triangles touching a pole would be degenerate, all vertices of a pole sit on the same point
+			if (ring != 0) {
+				mesh.indices.insert(mesh.indices.end(), { a, d, b });
+			}
+			if (ring != rings - 1) {
+				mesh.indices.insert(mesh.indices.end(), { d, c, b });
+			}
+		}
+	}
+
+	return mesh;
+}
+
+// The position, texture coordinate and normal indices of an OBJ face corner. Corners with the same three share a vertex
+struct ObjCorner {
+	uint32_t position;
+	uint32_t texCoord;
+	uint32_t normal;
+
+	bool operator==(const ObjCorner& other) const {
+		return position == other.position && texCoord == other.texCoord && normal == other.normal;
+	}
+};
+
+struct ObjCornerHash {
+	size_t operator()(const ObjCorner& corner) const {
+		uint64_t hash = Hash::combine(Hash::offsetBasis, corner.position);
+		hash = Hash::combine(hash, corner.texCoord);
+		hash = Hash::combine(hash, corner.normal);
+		return static_cast<size_t>(hash);
+	}
+};
+
+MeshData MeshData::loadObj(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open mesh file: " + filename);
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+
+	MeshData mesh;
+	std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> shared; // corner -> vertex
+	bool generateNormals = false;
+
+	// OBJ indices are 1-based, negative ones count back from the last element read so far. 0 means the element is missing
+	auto resolve = [](long index, size_t count) -> uint32_t {
+		if (index < 0) {
+			index += static_cast<long>(count) + 1;
+		}
+		if (index < 0 || static_cast<size_t>(index) > count) {
+			throw std::runtime_error("mesh file references an element that doesn't exist!");
+		}
+		return static_cast<uint32_t>(index);
+	};
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+
+		if (keyword == "v") {
+			glm::vec3 position;
+			stream >> position.x >> position.y >> position.z;
+			positions.push_back(position);
+		}
+		else if (keyword == "vt") {
+			glm::vec2 texCoord;
+			stream >> texCoord.x >> texCoord.y;
+			texCoords.push_back(glm::vec2(texCoord.x, 1.0f - texCoord.y)); // OBJ puts v = 0 at the bottom of the image, Vulkan at the top
+		}
+		else if (keyword == "vn") {
+			glm::vec3 normal;
+			stream >> normal.x >> normal.y >> normal.z;
+			normals.push_back(normal);
+		}
+		else if (keyword == "f") {
+			std::vector<uint32_t> face;
+			std::string corner;
+			while (stream >> corner) { // v, v/vt, v//vn or v/vt/vn
+				long elements[3] = { 0, 0, 0 };
+				size_t start = 0;
+				for (int i = 0; i < 3 && start <= corner.size(); i++) {
+					size_t slash = corner.find('/', start);
+					std::string element = corner.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+					if (!element.empty()) {
+						elements[i] = std::stol(element);
+					}
+					if (slash == std::string::npos) {
+						break;
+					}
+					start = slash + 1;
+				}
+
+				uint32_t position = resolve(elements[0], positions.size());
+				uint32_t texCoord = resolve(elements[1], texCoords.size());
+				uint32_t normal = resolve(elements[2], normals.size());
+				if (position == 0) {
+					throw std::runtime_error("mesh file has a face corner without a position!");
+				}
+
+				ObjCorner key{ position, texCoord, normal };
+				auto existing = shared.find(key);
+				if (existing != shared.end()) {
+					face.push_back(existing->second);
+					continue;
+				}
+
+				MeshVertex vertex{};
+				vertex.position = positions[position - 1];
+				vertex.normal = normal != 0 ? normals[normal - 1] : glm::vec3(0.0f);
+				vertex.tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+				vertex.texCoord = texCoord != 0 ? texCoords[texCoord - 1] : glm::vec2(0.0f);
+				vertex.color = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
+				generateNormals |= normal == 0;
+
+				uint32_t index = static_cast<uint32_t>(mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+				shared.emplace(key, index);
+				face.push_back(index);
+			}
+
+			for (size_t i = 2; i < face.size(); i++) { // fan, OBJ polygons are convex
+				mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+			}
+		}
+	}
+
+	if (generateNormals) { // area weighted face normals, summed into the vertices that came without one
+		std::vector<glm::vec3> generated(mesh.vertices.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+			const glm::vec3& a = mesh.vertices[mesh.indices[i]].position;
+			const glm::vec3& b = mesh.vertices[mesh.indices[i + 1]].position;
+			const glm::vec3& c = mesh.vertices[mesh.indices[i + 2]].position;
+			glm::vec3 faceNormal = glm::cross(b - a, c - a);
+			for (size_t corner = 0; corner < 3; corner++) {
+				generated[mesh.indices[i + corner]] += faceNormal;
+			}
+		}
+		for (size_t i = 0; i < mesh.vertices.size(); i++) {
+			if (mesh.vertices[i].normal == glm::vec3(0.0f)) {
+				float length = glm::length(generated[i]);
+				mesh.vertices[i].normal = length > 0.0f ? generated[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			}
+		}
+	}
+
+	return mesh;
+}
+
+void MeshData::getBounds(glm::vec3& center, float& radius) const {
+	center = glm::vec3(0.0f);
+	radius = 0.0f;
+	if (vertices.empty()) {
+		return;
+	}
+
+	glm::vec3 minimum = vertices[0].position;
+	glm::vec3 maximum = minimum;
+	for (const auto& vertex : vertices) {
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+
+	center = (minimum + maximum) * 0.5f;
+	for (const auto& vertex : vertices) {
+		radius = std::max(radius, glm::length(vertex.position - center));
+	}
+}
+
+EncodedMesh EncodedMesh::encode(const MeshData& mesh, const VertexFormat& format) {
+	if (mesh.vertices.empty() || mesh.indices.empty()) {
+		throw std::runtime_error("cannot encode an empty mesh!");
+	}
+
+	EncodedMesh encoded;
+	encoded.format = format;
+	encoded.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	encoded.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	encoded.indexType = format.indexType(encoded.vertexCount);
+
+	glm::vec3 positionMin = mesh.vertices[0].position;
+	glm::vec3 positionMax = positionMin;
+	glm::vec2 texCoordMin = mesh.vertices[0].texCoord;
+	glm::vec2 texCoordMax = texCoordMin;
+	for (const auto& vertex : mesh.vertices) {
+		positionMin = glm::min(positionMin, vertex.position);
+		positionMax = glm::max(positionMax, vertex.position);
+		texCoordMin = glm::min(texCoordMin, vertex.texCoord);
+		texCoordMax = glm::max(texCoordMax, vertex.texCoord);
+	}
+
+	if (format.position == PositionEncoding::Snorm16) { // [-1, 1] covers the bounds, flat axes get a scale that keeps the division finite
+		encoded.positionOffset = (positionMin + positionMax) * 0.5f;
+		encoded.positionScale = glm::max((positionMax - positionMin) * 0.5f, glm::vec3(1e-6f));
+	}
+	if (format.texCoord == TexCoordEncoding::Unorm16) { // [0, 1] covers the range, so tiling coordinates outside of it survive too
+		encoded.texCoordOffset = texCoordMin;
+		encoded.texCoordScale = glm::max(texCoordMax - texCoordMin, glm::vec2(1e-6f));
+	}
+
+	std::vector<VertexFormat::Attribute> attributes = format.attributes();
+	uint32_t stride = format.stride();
+	encoded.vertexData.assign(static_cast<size_t>(stride) * encoded.vertexCount, 0);
+
+	for (uint32_t i = 0; i < encoded.vertexCount; i++) {
+		const MeshVertex& vertex = mesh.vertices[i];
+		uint8_t* destination = encoded.vertexData.data() + static_cast<size_t>(i) * stride;
+
+		for (const auto& attribute : attributes) {
+			glm::vec4 value;
+			switch (attribute.attribute) {
+			case VertexAttribute::Position:
+				value = glm::vec4((vertex.position - encoded.positionOffset) / encoded.positionScale, 1.0f);
+				break;
+			case VertexAttribute::Normal:
+				value = format.octahedralDirections() ? glm::vec4(octahedralEncode(vertex.normal), 0.0f, 0.0f) : glm::vec4(vertex.normal, 0.0f);
+				break;
+			case VertexAttribute::Tangent:
+				value = format.octahedralDirections() ? glm::vec4(octahedralEncode(glm::vec3(vertex.tangent)), vertex.tangent.w, 0.0f) : vertex.tangent;
+				break;
+			case VertexAttribute::TexCoord:
+				value = glm::vec4((vertex.texCoord - encoded.texCoordOffset) / encoded.texCoordScale, 0.0f, 0.0f);
+				break;
+			case VertexAttribute::Color:
+				value = vertex.color;
+				break;
+			}
+			writeAttribute(destination + attribute.offset, attribute.format, value);
+		}
+	}
+
+	if (encoded.indexType == VK_INDEX_TYPE_UINT16) {
+		encoded.indexData.resize(mesh.indices.size() * sizeof(uint16_t));
+		uint16_t* indices = reinterpret_cast<uint16_t*>(encoded.indexData.data());
+		for (size_t i = 0; i < mesh.indices.size(); i++) {
+			indices[i] = static_cast<uint16_t>(mesh.indices[i]);
+		}
+	}
+	else {
+		encoded.indexData.resize(mesh.indices.size() * sizeof(uint32_t));
+		std::memcpy(encoded.indexData.data(), mesh.indices.data(), encoded.indexData.size());
+	}
+
+	return encoded;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "../headers/mesh_cooker.h"
+#include "../headers/hash.h"
+#include "../headers/mapped_file.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+// Layout of a cooked mesh file, followed by the vertices and then the indices
+struct CookedMeshHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+static const uint32_t cookedMeshMagic = 0x48534D48; // "HMSH"
+static const uint32_t cookedMeshVersion = 1; // bumped whenever the file layout or MeshVertex changes
+
+
+MeshCooker::MeshCooker(const std::string& cacheDirectory) {
+	this->cacheDirectory = cacheDirectory;
+}
+
+std::string MeshCooker::cookedPath(uint64_t key) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(cacheDirectory) / name).string();
+}
+
+bool MeshCooker::load(uint64_t key, Result& result) const {
+	std::ifstream file(cookedPath(key), std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	CookedMeshHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good() || header.magic != cookedMeshMagic || header.version != cookedMeshVersion) {
+		return false; // damaged or from an older build, cook it again and overwrite it
+	}
+
+	// the counts have to describe exactly what follows the header, a damaged one could ask for any amount of memory
+	std::streampos dataStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - dataStart;
+	file.seekg(dataStart);
+	uint64_t expectedSize = static_cast<uint64_t>(header.vertexCount) * sizeof(MeshVertex) + static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+	if (dataStart < 0 || remaining < 0 || expectedSize != static_cast<uint64_t>(remaining) || header.indexCount % 3 != 0) {
+		return false;
+	}
+
+	result.mesh.vertices.resize(header.vertexCount);
+	result.mesh.indices.resize(header.indexCount);
+	file.read(reinterpret_cast<char*>(result.mesh.vertices.data()), result.mesh.vertices.size() * sizeof(MeshVertex));
+	file.read(reinterpret_cast<char*>(result.mesh.indices.data()), result.mesh.indices.size() * sizeof(uint32_t));
+	if (!file.good()) {
+		return false;
+	}
+	for (uint32_t index : result.mesh.indices) {
+		if (index >= header.vertexCount) {
+			return false;
+		}
+	}
+
+	result.before = header.before;
+	result.after = header.after;
+	result.cached = true;
+	return true;
+}
+
+void MeshCooker::store(uint64_t key, const Result& result) const {
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	// written to a temporary file and renamed, so a cook that is interrupted never leaves a truncated mesh behind
+	std::filesystem::path path = cookedPath(key);
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	CookedMeshHeader header{ cookedMeshMagic, cookedMeshVersion, static_cast<uint32_t>(result.mesh.vertices.size()), static_cast<uint32_t>(result.mesh.indices.size()), result.before, result.after };
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(result.mesh.vertices.data()), result.mesh.vertices.size() * sizeof(MeshVertex));
+		file.write(reinterpret_cast<const char*>(result.mesh.indices.data()), result.mesh.indices.size() * sizeof(uint32_t));
+		if (!file.good()) {
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+MeshCooker::Result MeshCooker::cookFile(const std::string& filename) const {
+	uint64_t sourceKey;
+	{
+		MappedFile source(filename); // throws if the file doesn't exist
+		sourceKey = Hash::bytes(source.getData(), source.getSize());
+	}
+	sourceKey = Hash::string(std::filesystem::path(filename).extension().string(), sourceKey);
+
+	return cook(sourceKey, [&filename]() {
+		return MeshData::loadObj(filename);
+	});
+}
+
+MeshCooker::Result MeshCooker::cook(uint64_t sourceKey, const std::function<MeshData()>& generate) const {
+	uint64_t key = Hash::combine(sourceKey, MeshOptimizer::version);
+
+	Result result;
+	if (load(key, result)) {
+		return result;
+	}
+
+	result.mesh = generate();
+	MeshOptimizer::optimize(result.mesh, result.before, result.after);
+	store(key, result);
+	return result;
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "../headers/mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// FIFO cache simulation shared by the analysis and the overdraw pass. A vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+class FifoCache {
+
+private:
+
+	std::vector<uint32_t> timestamps;
+	uint32_t cacheSize;
+	uint32_t timestamp;
+
+public:
+
+	FifoCache(uint32_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), cacheSize(cacheSize), timestamp(cacheSize + 1) {}
+
+	// Returns 1 if the vertex had to be transformed
+	uint32_t access(uint32_t vertex) {
+		if (timestamp - timestamps[vertex] > cacheSize) {
+			timestamps[vertex] = timestamp++;
+			return 1;
+		}
+		return 0;
+	}
+
+	void clear() {
+		timestamp += cacheSize + 1;
+	}
+
+};
+
+// Forsyth's vertex score: vertices of the last triangle score a fixed amount, older cache entries less the further back they are, and vertices with few
+// triangles left get a boost so they are finished off instead of being left to miss the cache later
+static const uint32_t scoreCacheSize = 32;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+	if (remainingTriangles == 0) {
+		return -1.0f; // nothing left to draw with it
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			score = 0.75f; // deliberately lower than the next entries, so a strip doesn't keep walking along the same edge
+		}
+		else {
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (scoreCacheSize - 3), 1.5f);
+		}
+	}
+	return score + 2.0f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+}
+
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStats stats;
+	if (indices.empty()) {
+		return stats;
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t misses = 0;
+	uint32_t referencedCount = 0;
+	for (uint32_t index : indices) {
+		misses += cache.access(index);
+		if (!referenced[index]) {
+			referenced[index] = true;
+			referencedCount++;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+	stats.atvr = static_cast<float>(misses) / referencedCount;
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// triangles using each vertex, the ones not drawn yet are kept at the front of each vertex's range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices) {
+		remaining[index]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::partial_sum(remaining.begin(), remaining.end(), adjacencyOffsets.begin() + 1);
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		vertexScores[vertex] = vertexScore(-1, remaining[vertex]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+		triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	size_t cursor = 0; // the next triangle in input order that may not have been drawn, where drawing continues when no cached vertex has triangles left
+
+	int64_t best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+	for (size_t drawn = 0; drawn < triangleCount; drawn++) {
+		if (best < 0) {
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = static_cast<int64_t>(cursor);
+		}
+
+		const uint32_t* triangle = &indices[best * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[best] = true;
+
+		newCache.clear();
+		for (int i = 0; i < 3; i++) {
+			uint32_t vertex = triangle[i];
+
+			uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t* end = begin + remaining[vertex];
+			std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end - 1);
+			remaining[vertex]--;
+
+			if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) { // degenerate triangles repeat vertices
+				newCache.push_back(vertex);
+			}
+		}
+		for (uint32_t vertex : cache) {
+			if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+				newCache.push_back(vertex);
+			}
+		}
+
+		// rescore the cached vertices and the vertices that just fell out, then every triangle they still belong to
+		for (size_t i = 0; i < newCache.size(); i++) {
+			uint32_t vertex = newCache[i];
+			cachePositions[vertex] = i < scoreCacheSize ? static_cast<int>(i) : -1;
+			vertexScores[vertex] = vertexScore(cachePositions[vertex], remaining[vertex]);
+		}
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t vertex : newCache) {
+			for (uint32_t i = 0; i < remaining[vertex]; i++) {
+				uint32_t candidate = adjacency[adjacencyOffsets[vertex] + i];
+				const uint32_t* corners = &indices[candidate * 3];
+				triangleScores[candidate] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+				if (triangleScores[candidate] > bestScore) {
+					bestScore = triangleScores[candidate];
+					best = candidate;
+				}
+			}
+		}
+
+		newCache.resize(std::min<size_t>(newCache.size(), scoreCacheSize));
+		std::swap(cache, newCache);
+	}
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, float threshold) {
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0) {
+		return;
+	}
+
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	FifoCache cache(vertexCount, simulatedCacheSize);
+	auto triangleMisses = [&](uint32_t triangle) {
+		return cache.access(indices[triangle * 3]) + cache.access(indices[triangle * 3 + 1]) + cache.access(indices[triangle * 3 + 2]);
+	};
+
+	// hard boundaries, where every vertex of a triangle misses. The cache is cold there anyway, so reordering the clusters costs nothing
+	std::vector<uint32_t> hardClusters;
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+		if (triangleMisses(triangle) == 3) {
+			hardClusters.push_back(triangle);
+		}
+	}
+	hardClusters.push_back(triangleCount);
+
+	// soft boundaries split the clusters further, wherever the ACMR since the last boundary is still within threshold of the whole cluster's
+	std::vector<uint32_t> clusters;
+	for (size_t i = 0; i + 1 < hardClusters.size(); i++) {
+		uint32_t start = hardClusters[i];
+		uint32_t end = hardClusters[i + 1];
+
+		cache.clear();
+		uint32_t clusterMisses = 0;
+		for (uint32_t triangle = start; triangle < end; triangle++) {
+			clusterMisses += triangleMisses(triangle);
+		}
+		float clusterThreshold = threshold * clusterMisses / (end - start);
+
+		cache.clear();
+		clusters.push_back(start);
+		uint32_t subStart = start;
+		uint32_t misses = 0;
+		for (uint32_t triangle = start; triangle < end; triangle++) {
+			misses += triangleMisses(triangle);
+			if (triangle + 1 < end && static_cast<float>(misses) / (triangle + 1 - subStart) <= clusterThreshold) {
+				clusters.push_back(triangle + 1);
+				subStart = triangle + 1;
+				misses = 0;
+				cache.clear();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	glm::vec3 meshCentroid(0.0f);
+	for (const auto& vertex : vertices) {
+		meshCentroid += vertex.position;
+	}
+	meshCentroid /= static_cast<float>(vertices.size());
+
+	// clusters far out along the direction they face are likely to cover the rest of the mesh, so they are drawn first
+	struct Cluster {
+		uint32_t start;
+		uint32_t end;
+		float sortKey;
+	};
+	std::vector<Cluster> sorted;
+	for (size_t i = 0; i + 1 < clusters.size(); i++) {
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t triangle = clusters[i]; triangle < clusters[i + 1]; triangle++) {
+			const glm::vec3& a = vertices[indices[triangle * 3]].position;
+			const glm::vec3& b = vertices[indices[triangle * 3 + 1]].position;
+			const glm::vec3& c = vertices[indices[triangle * 3 + 2]].position;
+
+			glm::vec3 areaNormal = glm::cross(b - a, c - a); // length is twice the area
+			float triangleArea = glm::length(areaNormal);
+			centroid += (a + b + c) * (triangleArea / 3.0f);
+			normal += areaNormal;
+			area += triangleArea;
+		}
+
+		float sortKey = 0.0f;
+		float normalLength = glm::length(normal);
+		if (area > 0.0f && normalLength > 0.0f) {
+			sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+		}
+		sorted.push_back({ clusters[i], clusters[i + 1], sortKey });
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const auto& cluster : sorted) {
+		result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+	}
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<MeshVertex> result;
+	result.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(result);
+}
+
+void MeshOptimizer::optimize(MeshData& mesh, VertexCacheStats& before, VertexCacheStats& after) {
+	before = analyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+
+	optimizeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+	optimizeOverdraw(mesh.indices, mesh.vertices);
+	optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+	after = analyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../headers/meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Bounding sphere and normal cone of the meshlet that was just finished
+static MeshletBounds computeBounds(const MeshData& mesh, const MeshletData& data, const Meshlet& meshlet) {
+	MeshletBounds bounds{};
+
+	glm::vec3 minimum = mesh.vertices[data.vertices[meshlet.vertexOffset]].position;
+	glm::vec3 maximum = minimum;
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		const glm::vec3& position = mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+	bounds.center = (minimum + maximum) * 0.5f;
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		bounds.radius = std::max(bounds.radius, glm::length(mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position - bounds.center));
+	}
+
+	std::vector<glm::vec3> normals;
+	glm::vec3 normalSum(0.0f);
+	for (uint32_t i = 0; i < meshlet.triangleCount; i++) {
+		uint32_t packed = data.triangles[meshlet.triangleOffset + i];
+		const glm::vec3& a = mesh.vertices[data.vertices[meshlet.vertexOffset + (packed & 0xFF)]].position;
+		const glm::vec3& b = mesh.vertices[data.vertices[meshlet.vertexOffset + ((packed >> 8) & 0xFF)]].position;
+		const glm::vec3& c = mesh.vertices[data.vertices[meshlet.vertexOffset + ((packed >> 16) & 0xFF)]].position;
+
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if (length > 0.0f) { // degenerate triangles face nowhere and can't be back-facing
+			normals.push_back(normal / length);
+			normalSum += normal / length;
+		}
+	}
+
+	// no cull unless every triangle faces within a bit less than 90 degrees of the axis
+	bounds.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	bounds.coneCutoff = 1.0f;
+
+	float axisLength = glm::length(normalSum);
+	if (normals.empty() || axisLength == 0.0f) {
+		return bounds;
+	}
+
+	glm::vec3 axis = normalSum / axisLength;
+	float minimumDot = 1.0f;
+	for (const auto& normal : normals) {
+		minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+	}
+	if (minimumDot <= 0.1f) {
+		return bounds;
+	}
+
+	bounds.coneAxis = axis;
+	bounds.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+	return bounds;
+}
+
+
+MeshletData MeshletData::build(const MeshData& mesh) {
+	MeshletData data;
+
+	// meshlet-local index of each mesh vertex in the meshlet being filled, or -1
+	std::vector<int32_t> localIndices(mesh.vertices.size(), -1);
+	Meshlet current{ 0, 0, 0, 0 };
+
+	auto finish = [&]() {
+		if (current.triangleCount == 0) {
+			return;
+		}
+		data.meshlets.push_back(current);
+		data.bounds.push_back(computeBounds(mesh, data, current));
+
+		for (uint32_t i = 0; i < current.vertexCount; i++) {
+			localIndices[data.vertices[current.vertexOffset + i]] = -1;
+		}
+		current = { static_cast<uint32_t>(data.vertices.size()), static_cast<uint32_t>(data.triangles.size()), 0, 0 };
+	};
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		const uint32_t* triangle = &mesh.indices[i];
+
+		uint32_t newVertices = 0;
+		for (int corner = 0; corner < 3; corner++) {
+			bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+			if (localIndices[triangle[corner]] < 0 && !repeated) {
+				newVertices++;
+			}
+		}
+		if (current.vertexCount + newVertices > Meshlet::maxVertices || current.triangleCount + 1 > Meshlet::maxTriangles) {
+			finish();
+		}
+
+		uint32_t packed = 0;
+		for (int corner = 0; corner < 3; corner++) {
+			uint32_t vertex = triangle[corner];
+			if (localIndices[vertex] < 0) {
+				localIndices[vertex] = static_cast<int32_t>(current.vertexCount++);
+				data.vertices.push_back(vertex);
+			}
+			packed |= static_cast<uint32_t>(localIndices[vertex]) << (corner * 8);
+		}
+		data.triangles.push_back(packed);
+		current.triangleCount++;
+	}
+	finish();
+
+	return data;
+}
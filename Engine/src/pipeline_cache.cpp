@@ -0,0 +1,179 @@
+#pragma once
+
+#include "../headers/pipeline_cache.h"
+#include "../headers/hash.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+PipelineCache::PipelineCache(VkDevice& logicalDevice, VkPhysicalDevice physicalDevice, const std::string& cachePath) {
+	this->logicalDevice = logicalDevice;
+	this->cachePath = cachePath;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	std::vector<char> initialData = loadValidatedData();
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = initialData.size();
+	createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	if (vkCreatePipelineCache(logicalDevice, &createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		// the driver rejected the data even though it passed our checks, start with an empty cache instead
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		if (vkCreatePipelineCache(logicalDevice, &createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+}
+
+std::vector<char> PipelineCache::loadValidatedData() {
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file.is_open()) {
+		return {}; // no cache yet, first run
+	}
+
+	FileHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		return {};
+	}
+
+	if (header.magic != fileMagic || header.version != fileVersion ||
+		header.vendorID != deviceProperties.vendorID ||
+		header.deviceID != deviceProperties.deviceID ||
+		header.driverVersion != deviceProperties.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		std::cout << "pipeline cache was written by a different device or driver, rebuilding it" << std::endl;
+		return {};
+	}
+
+	// check the size against what is actually left in the file before allocating, a corrupt header could ask for anything
+	std::streampos dataStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - dataStart;
+	file.seekg(dataStart);
+	if (dataStart < 0 || remaining < 0 || header.dataSize > static_cast<uint64_t>(remaining)) {
+		std::cout << "pipeline cache is truncated, rebuilding it" << std::endl;
+		return {};
+	}
+
+	std::vector<char> data(static_cast<size_t>(header.dataSize));
+	if (!file.read(data.data(), data.size()) || Hash::bytes(data.data(), data.size()) != header.dataHash) {
+		std::cout << "pipeline cache is corrupt, rebuilding it" << std::endl;
+		return {};
+	}
+
+	// The driver data starts with a VkPipelineCacheHeaderVersionOne, check it as well in case the driver doesn't
+	VkPipelineCacheHeaderVersionOne driverHeader{};
+	if (data.size() < sizeof(driverHeader)) {
+		return {};
+	}
+	std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+
+	if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		driverHeader.vendorID != deviceProperties.vendorID ||
+		driverHeader.deviceID != deviceProperties.deviceID ||
+		std::memcmp(driverHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		return {};
+	}
+
+	return data;
+}
+
+VkPipelineCache PipelineCache::getHandle() const {
+	return pipelineCache;
+}
+
+VkPipelineCache PipelineCache::createWorkerCache() {
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	VkPipelineCache workerCache;
+	if (vkCreatePipelineCache(logicalDevice, &createInfo, nullptr, &workerCache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create worker pipeline cache!");
+	}
+
+	std::lock_guard<std::mutex> lock(workerMutex);
+	workerCaches.push_back(workerCache);
+	return workerCache;
+}
+
+void PipelineCache::mergeWorkerCaches() {
+	std::lock_guard<std::mutex> lock(workerMutex);
+	if (workerCaches.empty()) {
+		return;
+	}
+
+	if (vkMergePipelineCaches(logicalDevice, pipelineCache, static_cast<uint32_t>(workerCaches.size()), workerCaches.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to merge pipeline caches!");
+	}
+}
+
+void PipelineCache::save() {
+	mergeWorkerCaches();
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+		return; // not fatal, the next run just starts cold
+	}
+	data.resize(dataSize);
+
+	FileHeader header{};
+	header.magic = fileMagic;
+	header.version = fileVersion;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataHash = Hash::bytes(data.data(), data.size());
+
+	std::filesystem::path path(cachePath);
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	std::error_code error;
+	if (path.has_parent_path()) {
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "failed to write pipeline cache to " << tempPath.string() << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file.good()) {
+			std::cerr << "failed to write pipeline cache to " << tempPath.string() << std::endl;
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error); // replaces the old file in one step
+	if (error) {
+		std::cerr << "failed to replace pipeline cache: " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+void PipelineCache::destroy() {
+	std::lock_guard<std::mutex> lock(workerMutex);
+	for (auto workerCache : workerCaches) {
+		vkDestroyPipelineCache(logicalDevice, workerCache, nullptr);
+	}
+	workerCaches.clear();
+
+	vkDestroyPipelineCache(logicalDevice, pipelineCache, nullptr);
+	pipelineCache = VK_NULL_HANDLE;
+}
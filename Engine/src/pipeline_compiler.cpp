@@ -0,0 +1,202 @@
+#pragma once
+
+#include "../headers/pipeline_compiler.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+
+PipelineCompiler::PipelineCompiler(VkDevice& logicalDevice, PipelineCache& pipelineCache, ThreadPool& threadPool)
+	: pipelineCache(pipelineCache), threadPool(threadPool) {
+	this->logicalDevice = logicalDevice;
+
+	for (uint32_t i = 0; i < threadPool.size(); i++) {
+		workerCaches.push_back(pipelineCache.createWorkerCache());
+	}
+}
+
+VkPipeline PipelineCompiler::registerFallback(VkPipeline fallback) {
+	fallbacks.push_back(fallback);
+	if (defaultFallback == VK_NULL_HANDLE) {
+		defaultFallback = fallback;
+	}
+	return fallback;
+}
+
+PipelineHandle PipelineCompiler::submit(const GraphicsPipelineDesc& desc, VkPipeline fallback) {
+	PipelineHandle handle = static_cast<PipelineHandle>(slots.size());
+	PipelineSlot& slot = slots.emplace_back();
+	slot.fallback.store(fallback != VK_NULL_HANDLE ? fallback : defaultFallback, std::memory_order_relaxed);
+
+	if (slot.fallback.load(std::memory_order_relaxed) == VK_NULL_HANDLE) {
+		GraphicsPipelineDesc fallbackDesc = desc;
+		fallbackDesc.flags |= VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT; // the same state, so a permutation variant looks the same before it is optimized
+
+		// queued first, so the pool starts on it before the slower optimized compile
+		slot.generatedFallback = threadPool.submit([this, &slot, fallbackDesc]() {
+			try {
+				VkPipeline pipeline = compile(fallbackDesc);
+				slot.fallback.store(pipeline, std::memory_order_release);
+				return pipeline;
+			}
+			catch (const std::exception& e) {
+				std::cerr << e.what() << std::endl; // the draw is skipped until the optimized pipeline is done
+				return static_cast<VkPipeline>(VK_NULL_HANDLE);
+			}
+		}).share();
+	}
+
+	// the description is copied into the task, the caller's copy can go away before the compile starts
+	slot.compiled = threadPool.submit([this, &slot, desc]() {
+		try {
+			VkPipeline pipeline = compile(desc);
+			slot.pipeline.store(pipeline, std::memory_order_release);
+			return pipeline;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl; // keep drawing with the fallback, the error is also rethrown from the future
+			throw;
+		}
+	}).share();
+
+	return handle;
+}
+
+void PipelineCompiler::rebuild(PipelineHandle handle, const GraphicsPipelineDesc& desc) {
+	PipelineSlot& slot = slots[handle];
+
+	bool initialCompileRunning = slot.compiled.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+	if (slot.rebuilding || initialCompileRunning) {
+		slot.queuedRebuild = std::make_unique<GraphicsPipelineDesc>(desc); // only the newest request matters, it replaces any older queued one
+		if (std::find(rebuildingHandles.begin(), rebuildingHandles.end(), handle) == rebuildingHandles.end()) {
+			rebuildingHandles.push_back(handle);
+		}
+		return;
+	}
+
+	startRebuild(slot, desc);
+	rebuildingHandles.push_back(handle);
+}
+
+void PipelineCompiler::startRebuild(PipelineSlot& slot, const GraphicsPipelineDesc& desc) {
+	slot.rebuilding = true;
+	slot.rebuilt = threadPool.submit([this, desc]() {
+		try {
+			return compile(desc);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl; // keep using the current pipeline
+			return static_cast<VkPipeline>(VK_NULL_HANDLE);
+		}
+	}).share();
+}
+
+std::vector<VkPipeline> PipelineCompiler::publishRebuilds() {
+	std::vector<VkPipeline> replaced;
+	std::vector<PipelineHandle> stillRebuilding;
+
+	for (PipelineHandle handle : rebuildingHandles) {
+		PipelineSlot& slot = slots[handle];
+
+		if (slot.rebuilding) {
+			if (slot.rebuilt.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				stillRebuilding.push_back(handle);
+				continue;
+			}
+
+			slot.rebuilding = false;
+			VkPipeline pipeline = slot.rebuilt.get();
+			if (pipeline != VK_NULL_HANDLE) {
+				VkPipeline previous = slot.pipeline.exchange(pipeline, std::memory_order_acq_rel);
+				if (previous != VK_NULL_HANDLE) {
+					replaced.push_back(previous);
+				}
+			}
+		}
+
+		if (slot.queuedRebuild) {
+			if (slot.compiled.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				stillRebuilding.push_back(handle); // wait for the initial compile so the rebuild can't be overwritten by it
+				continue;
+			}
+			startRebuild(slot, *slot.queuedRebuild);
+			slot.queuedRebuild.reset();
+			stillRebuilding.push_back(handle);
+		}
+	}
+
+	rebuildingHandles = std::move(stillRebuilding);
+	return replaced;
+}
+
+VkPipeline PipelineCompiler::compile(const GraphicsPipelineDesc& desc) {
+	int worker = ThreadPool::currentWorkerIndex();
+	VkPipelineCache cache = worker >= 0 && worker < static_cast<int>(workerCaches.size()) ? workerCaches[worker] : pipelineCache.getHandle();
+	return desc.create(logicalDevice, cache);
+}
+
+VkPipeline PipelineCompiler::getPipeline(PipelineHandle handle) const {
+	const PipelineSlot& slot = slots[handle];
+	VkPipeline pipeline = slot.pipeline.load(std::memory_order_acquire);
+	return pipeline != VK_NULL_HANDLE ? pipeline : slot.fallback.load(std::memory_order_acquire);
+}
+
+VkPipeline PipelineCompiler::waitForPipeline(PipelineHandle handle) const {
+	VkPipeline pipeline = getPipeline(handle);
+	const PipelineSlot& slot = slots[handle];
+	if (pipeline == VK_NULL_HANDLE && slot.generatedFallback.valid()) {
+		slot.generatedFallback.wait();
+		pipeline = getPipeline(handle);
+	}
+	return pipeline;
+}
+
+bool PipelineCompiler::isReady(PipelineHandle handle) const {
+	return slots[handle].pipeline.load(std::memory_order_acquire) != VK_NULL_HANDLE;
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::getFuture(PipelineHandle handle) const {
+	return slots[handle].compiled;
+}
+
+static bool isRunning(const std::shared_future<VkPipeline>& compile) {
+	return compile.valid() && compile.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+uint32_t PipelineCompiler::pendingCount() const {
+	uint32_t pending = 0;
+	for (const auto& slot : slots) {
+		if (isRunning(slot.compiled) || isRunning(slot.generatedFallback) || (slot.rebuilding && isRunning(slot.rebuilt)) || slot.queuedRebuild) {
+			pending++;
+		}
+	}
+	return pending;
+}
+
+void PipelineCompiler::destroy() {
+	for (auto& slot : slots) {
+		slot.compiled.wait(); // a worker may still be writing to the slot
+		VkPipeline pipeline = slot.pipeline.load(std::memory_order_acquire);
+		if (pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+		}
+
+		if (slot.generatedFallback.valid() && slot.generatedFallback.get() != VK_NULL_HANDLE) {
+			vkDestroyPipeline(logicalDevice, slot.generatedFallback.get(), nullptr);
+		}
+
+		if (slot.rebuilding && slot.rebuilt.get() != VK_NULL_HANDLE) { // finished but never published
+			vkDestroyPipeline(logicalDevice, slot.rebuilt.get(), nullptr);
+		}
+	}
+	slots.clear();
+	rebuildingHandles.clear();
+
+	for (auto fallback : fallbacks) {
+		vkDestroyPipeline(logicalDevice, fallback, nullptr);
+	}
+	fallbacks.clear();
+	defaultFallback = VK_NULL_HANDLE;
+
+	workerCaches.clear(); // owned and destroyed by the pipeline cache
+}
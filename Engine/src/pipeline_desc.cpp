@@ -0,0 +1,169 @@
+#pragma once
+
+#include "../headers/pipeline_desc.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+void GraphicsPipelineDesc::ShaderStage::setSpecializationConstant(uint32_t constantId, uint32_t value) {
+	for (const auto& entry : specializationEntries) {
+		if (entry.constantID == constantId) {
+			std::memcpy(specializationData.data() + entry.offset, &value, sizeof(value));
+			return;
+		}
+	}
+
+	VkSpecializationMapEntry entry{};
+	entry.constantID = constantId;
+	entry.offset = static_cast<uint32_t>(specializationData.size());
+	entry.size = sizeof(value);
+	specializationEntries.push_back(entry);
+
+	specializationData.resize(specializationData.size() + sizeof(value));
+	std::memcpy(specializationData.data() + entry.offset, &value, sizeof(value));
+}
+
+VkPipelineColorBlendAttachmentState GraphicsPipelineDesc::alphaBlendAttachment() {
+	// color blending - combine the color of what is already in the framebuffer with the color of the new fragment being written
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	return colorBlendAttachment;
+}
+
+VkPipeline GraphicsPipelineDesc::create(VkDevice logicalDevice, VkPipelineCache cache) const {
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStages; // define the shaders stages in our pipeline
+	std::vector<VkSpecializationInfo> specializationInfos(stages.size()); // sized up front, the stage infos point into it
+	for (size_t i = 0; i < stages.size(); i++) {
+		const ShaderStage& stage = stages[i];
+
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; // struct type
+		stageInfo.stage = stage.stage; // shader stage
+		stageInfo.module = stage.module; // shader module
+		stageInfo.pName = stage.entryPoint.c_str(); // entry point - usually the main function
+
+		// constant values baked in at pipeline creation, the driver folds them and drops the branches they disable
+		if (!stage.specializationEntries.empty()) {
+			specializationInfos[i].mapEntryCount = static_cast<uint32_t>(stage.specializationEntries.size());
+			specializationInfos[i].pMapEntries = stage.specializationEntries.data();
+			specializationInfos[i].dataSize = stage.specializationData.size();
+			specializationInfos[i].pData = stage.specializationData.data();
+			stageInfo.pSpecializationInfo = &specializationInfos[i];
+		}
+
+		shaderStages.push_back(stageInfo);
+	}
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = vertexBindings.data(); // describes the format of the vertex data
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data(); // describes the attributes passed to the vertex shader
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = topology; // primitive topology - how the vertices are used to form primitives/geometries
+	inputAssembly.primitiveRestartEnable = VK_FALSE; // periodically restart the drawing of primitives from the beginning of the current draw call
+
+	// viewport and scissor are dynamic state, only their count is baked into the pipeline
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{}; // rasterizer - turns the geometry from the vertex shader into fragments, also performs depth testing, face culling and the scissor window
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE; // if true, fragments that are beyond the near and far planes are clamped to them as opposed to discarding them (useful for shadow maps)
+	rasterizer.rasterizerDiscardEnable = VK_FALSE; // if true, geometry never passes through the rasterizer stage and nothing is drawn to the framebuffer
+	rasterizer.polygonMode = polygonMode; // fill the polygons with fragments to be colored. Other modes include line and point (think wireframe)
+	rasterizer.lineWidth = 1.0f; // line width in terms of number of fragments -- maximum linewidth is hardware dependent and >1f requires enabling a GPU feature
+	rasterizer.cullMode = cullMode;
+	rasterizer.frontFace = frontFace;
+
+	// depth bias - adds a constant value or a value proportional to the fragment's slope to the depth of the fragment (useful for shadow mapping). TODO: implement
+	rasterizer.depthBiasEnable = VK_FALSE;
+	rasterizer.depthBiasConstantFactor = 0.0f; // Optional
+	rasterizer.depthBiasClamp = 0.0f; // Optional
+	rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
+
+	// multisampling - efficient anti-aliasing technique. TODO: implement
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = rasterizationSamples;
+	multisampling.minSampleShading = 1.0f; // Optional
+	multisampling.pSampleMask = nullptr; // Optional
+	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+	multisampling.alphaToOneEnable = VK_FALSE; // Optional
+
+	// depth and stencil testing - compare the depth of the new fragment with the depth buffer to see if it should be discarded. TODO: implement stencil testing
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = depthCompareOp;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{}; // global color blending configuration
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+	colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+	colorBlending.pAttachments = colorBlendAttachments.data();
+	colorBlending.blendConstants[0] = 0.0f; // Optional
+	colorBlending.blendConstants[1] = 0.0f; // Optional
+	colorBlending.blendConstants[2] = 0.0f; // Optional
+	colorBlending.blendConstants[3] = 0.0f; // Optional
+
+	// create graphics pipeline with everything we've set up for it
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.flags = flags;
+	pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineInfo.pStages = shaderStages.data();
+
+	// fixed-function stage
+	// mesh shader pipelines produce their own primitives and have no vertex input or input assembly stage
+	bool meshPipeline = std::any_of(stages.begin(), stages.end(), [](const ShaderStage& stage) { return stage.stage == VK_SHADER_STAGE_MESH_BIT_EXT; });
+	pipelineInfo.pVertexInputState = meshPipeline ? nullptr : &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = meshPipeline ? nullptr : &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+
+	// pipeline layout
+	pipelineInfo.layout = layout;
+
+	// render pass
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = subpass; // index of th sub pass where the graphics pipeline will be used
+
+	// These parameters are used to create a new pipeline by deriving from an existing pipeline. Only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is set in the flags field of the VkGraphicsPipelineCreateInfo struct
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional - a pipeline to derive from
+	pipelineInfo.basePipelineIndex = -1; // Optional - an index to derive from
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(logicalDevice, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+
+	return pipeline;
+}
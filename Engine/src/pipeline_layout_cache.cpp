@@ -0,0 +1,215 @@
+#pragma once
+
+#include "../headers/pipeline_layout_cache.h"
+#include "../headers/hash.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+// Size of a 32-bit vertex format produced by the reflection
+static uint32_t formatSize(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_R32_SFLOAT: case VK_FORMAT_R32_SINT: case VK_FORMAT_R32_UINT: return 4;
+	case VK_FORMAT_R32G32_SFLOAT: case VK_FORMAT_R32G32_SINT: case VK_FORMAT_R32G32_UINT: return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT: case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32_UINT: return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT: case VK_FORMAT_R32G32B32A32_SINT: case VK_FORMAT_R32G32B32A32_UINT: return 16;
+	default: throw std::runtime_error("unsupported vertex format!");
+	}
+}
+
+// SPIR-V has no dynamic buffers, so a reserved set decides whether a uniform or storage buffer binding takes a dynamic offset
+static bool matchesReservedType(VkDescriptorType reflected, VkDescriptorType reserved) {
+	if (reflected == reserved) {
+		return true;
+	}
+	return (reflected == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && reserved == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) ||
+		(reflected == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && reserved == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+}
+
+
+PipelineLayoutCache::PipelineLayoutCache(VkDevice& logicalDevice) {
+	this->logicalDevice = logicalDevice;
+}
+
+ReflectedLayout PipelineLayoutCache::buildLayout(const std::vector<const ShaderReflection*>& stages) {
+	ReflectedLayout layout;
+
+	// set -> binding -> merged binding, ordered maps so the bindings come out sorted
+	std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+
+	uint32_t pushConstantBegin = UINT32_MAX;
+	uint32_t pushConstantEnd = 0;
+	VkShaderStageFlags pushConstantStages = 0;
+
+	for (const ShaderReflection* stage : stages) {
+		for (const auto& binding : stage->bindings) {
+			auto& merged = sets[binding.set][binding.binding];
+			if (merged.stageFlags == 0) {
+				merged.binding = binding.binding;
+				merged.descriptorType = binding.type;
+				merged.descriptorCount = binding.count;
+			}
+			else if (merged.descriptorType != binding.type) {
+				throw std::runtime_error("shader stages disagree about the type of a descriptor binding!");
+			}
+			merged.descriptorCount = std::max(merged.descriptorCount, binding.count);
+			merged.stageFlags |= stage->stage;
+		}
+
+		if (stage->pushConstantSize > 0) {
+			pushConstantBegin = std::min(pushConstantBegin, stage->pushConstantOffset);
+			pushConstantEnd = std::max(pushConstantEnd, stage->pushConstantOffset + stage->pushConstantSize);
+			pushConstantStages |= stage->stage;
+		}
+
+		if (stage->stage == VK_SHADER_STAGE_VERTEX_BIT) {
+			uint32_t offset = 0;
+			for (const auto& input : stage->vertexInputs) {
+				VkVertexInputAttributeDescription attribute{};
+				attribute.location = input.location;
+				attribute.binding = 0;
+				attribute.format = input.format;
+				attribute.offset = offset;
+				layout.vertexAttributes.push_back(attribute);
+				offset += formatSize(input.format);
+			}
+
+			if (offset > 0) {
+				VkVertexInputBindingDescription binding{};
+				binding.binding = 0;
+				binding.stride = offset;
+				binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+				layout.vertexBindings.push_back(binding);
+			}
+		}
+	}
+
+	uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+	for (uint32_t set = 0; set < setCount; set++) {
+		auto reserved = reservedSets.find(set);
+		auto used = sets.find(set);
+		if (reserved != reservedSets.end() && used != sets.end()) {
+			for (const auto& binding : used->second) {
+				if (binding.first >= reserved->second.bindingTypes.size() || !matchesReservedType(binding.second.descriptorType, reserved->second.bindingTypes[binding.first])) {
+					throw std::runtime_error("shader binding doesn't match its reserved descriptor set!");
+				}
+			}
+			layout.setLayouts.push_back(reserved->second.setLayout);
+			continue;
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		if (used != sets.end()) {
+			for (auto& binding : used->second) {
+				if (binding.second.descriptorCount == 0) {
+					throw std::runtime_error("runtime sized descriptor arrays are only supported in reserved descriptor sets!");
+				}
+				bindings.push_back(binding.second);
+			}
+		}
+		layout.setLayouts.push_back(getSetLayout(bindings)); // unused sets in between get an empty layout
+	}
+
+	if (pushConstantStages != 0) {
+		layout.pushConstantRanges.push_back({ pushConstantStages, pushConstantBegin, pushConstantEnd - pushConstantBegin });
+	}
+
+	layout.pipelineLayout = getPipelineLayout(layout.setLayouts, layout.pushConstantRanges);
+	return layout;
+}
+
+void PipelineLayoutCache::reserveSet(uint32_t set, VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorType>& bindingTypes) {
+	reservedSets[set] = { setLayout, bindingTypes };
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags) {
+	uint64_t key = Hash::combine(Hash::offsetBasis, flags);
+	for (const auto& binding : bindings) {
+		key = Hash::combine(key, binding.binding);
+		key = Hash::combine(key, binding.descriptorType);
+		key = Hash::combine(key, binding.descriptorCount);
+		key = Hash::combine(key, binding.stageFlags);
+	}
+
+	std::vector<CachedSetLayout>& cached = setLayouts[key];
+	for (const auto& entry : cached) {
+		bool same = entry.flags == flags && entry.bindings.size() == bindings.size();
+		for (size_t i = 0; same && i < bindings.size(); i++) {
+			same = entry.bindings[i].binding == bindings[i].binding && entry.bindings[i].descriptorType == bindings[i].descriptorType &&
+				entry.bindings[i].descriptorCount == bindings[i].descriptorCount && entry.bindings[i].stageFlags == bindings[i].stageFlags;
+		}
+		if (same) {
+			return entry.setLayout;
+		}
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.flags = flags;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VkDescriptorSetLayout setLayout;
+	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	cached.push_back({ flags, bindings, setLayout });
+	return setLayout;
+}
+
+VkPipelineLayout PipelineLayoutCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+	uint64_t key = Hash::offsetBasis;
+	for (auto setLayout : layouts) {
+		key = Hash::combine(key, setLayout);
+	}
+	for (const auto& range : pushConstantRanges) {
+		key = Hash::combine(key, range.stageFlags);
+		key = Hash::combine(key, range.offset);
+		key = Hash::combine(key, range.size);
+	}
+
+	std::vector<CachedPipelineLayout>& cached = pipelineLayouts[key];
+	for (const auto& entry : cached) {
+		bool same = entry.setLayouts == layouts && entry.pushConstantRanges.size() == pushConstantRanges.size();
+		for (size_t i = 0; same && i < pushConstantRanges.size(); i++) {
+			same = entry.pushConstantRanges[i].stageFlags == pushConstantRanges[i].stageFlags && entry.pushConstantRanges[i].offset == pushConstantRanges[i].offset &&
+				entry.pushConstantRanges[i].size == pushConstantRanges[i].size;
+		}
+		if (same) {
+			return entry.pipelineLayout;
+		}
+	}
+
+	// define the uniform values that will be used in the shaders
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+	pipelineLayoutInfo.pSetLayouts = layouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	cached.push_back({ layouts, pushConstantRanges, pipelineLayout });
+	return pipelineLayout;
+}
+
+void PipelineLayoutCache::destroy() {
+	for (auto& bucket : pipelineLayouts) {
+		for (auto& entry : bucket.second) {
+			vkDestroyPipelineLayout(logicalDevice, entry.pipelineLayout, nullptr);
+		}
+	}
+	pipelineLayouts.clear();
+
+	for (auto& bucket : setLayouts) {
+		for (auto& entry : bucket.second) {
+			vkDestroyDescriptorSetLayout(logicalDevice, entry.setLayout, nullptr);
+		}
+	}
+	setLayouts.clear();
+}
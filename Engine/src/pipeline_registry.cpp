@@ -0,0 +1,211 @@
+#pragma once
+
+#include "../headers/pipeline_registry.h"
+#include "../headers/hash.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+
+// the Vulkan structs are compared field by field, they can contain padding
+static bool sameBindings(const std::vector<VkVertexInputBindingDescription>& a, const std::vector<VkVertexInputBindingDescription>& b) {
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+		return x.binding == y.binding && x.stride == y.stride && x.inputRate == y.inputRate;
+	});
+}
+
+static bool sameAttributes(const std::vector<VkVertexInputAttributeDescription>& a, const std::vector<VkVertexInputAttributeDescription>& b) {
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+		return x.location == y.location && x.binding == y.binding && x.format == y.format && x.offset == y.offset;
+	});
+}
+
+static bool sameBlendAttachments(const std::vector<VkPipelineColorBlendAttachmentState>& a, const std::vector<VkPipelineColorBlendAttachmentState>& b) {
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+		return x.blendEnable == y.blendEnable && x.srcColorBlendFactor == y.srcColorBlendFactor && x.dstColorBlendFactor == y.dstColorBlendFactor &&
+			x.colorBlendOp == y.colorBlendOp && x.srcAlphaBlendFactor == y.srcAlphaBlendFactor && x.dstAlphaBlendFactor == y.dstAlphaBlendFactor &&
+			x.alphaBlendOp == y.alphaBlendOp && x.colorWriteMask == y.colorWriteMask;
+	});
+}
+
+bool PipelineStateKey::operator==(const PipelineStateKey& other) const {
+	if (stages.size() != other.stages.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < stages.size(); i++) {
+		if (stages[i].stage != other.stages[i].stage || stages[i].module != other.stages[i].module || stages[i].entryPoint != other.stages[i].entryPoint ||
+			stages[i].constants != other.stages[i].constants) {
+			return false;
+		}
+	}
+
+	return sameBindings(vertexBindings, other.vertexBindings) && sameAttributes(vertexAttributes, other.vertexAttributes) &&
+		sameBlendAttachments(colorBlendAttachments, other.colorBlendAttachments) && dynamicStates == other.dynamicStates &&
+		colorFormats == other.colorFormats && depthFormat == other.depthFormat && renderPass == other.renderPass &&
+		layout == other.layout && subpass == other.subpass && flags == other.flags &&
+		topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace && rasterizationSamples == other.rasterizationSamples &&
+		depthTest == other.depthTest && depthWrite == other.depthWrite && depthCompareOp == other.depthCompareOp;
+}
+
+size_t PipelineStateKeyHash::operator()(const PipelineStateKey& key) const {
+	uint64_t hash = Hash::offsetBasis;
+	for (const auto& stage : key.stages) {
+		hash = Hash::combine(hash, stage.stage);
+		hash = Hash::combine(hash, stage.module);
+		hash = Hash::string(stage.entryPoint, hash);
+		for (const auto& constant : stage.constants) {
+			hash = Hash::combine(hash, constant.first);
+			hash = Hash::bytes(constant.second.data(), constant.second.size(), hash);
+		}
+	}
+
+	for (const auto& binding : key.vertexBindings) {
+		hash = Hash::combine(hash, binding.binding);
+		hash = Hash::combine(hash, binding.stride);
+		hash = Hash::combine(hash, binding.inputRate);
+	}
+	for (const auto& attribute : key.vertexAttributes) {
+		hash = Hash::combine(hash, attribute.location);
+		hash = Hash::combine(hash, attribute.binding);
+		hash = Hash::combine(hash, attribute.format);
+		hash = Hash::combine(hash, attribute.offset);
+	}
+	for (const auto& attachment : key.colorBlendAttachments) {
+		hash = Hash::combine(hash, attachment.blendEnable);
+		hash = Hash::combine(hash, attachment.srcColorBlendFactor);
+		hash = Hash::combine(hash, attachment.dstColorBlendFactor);
+		hash = Hash::combine(hash, attachment.colorBlendOp);
+		hash = Hash::combine(hash, attachment.srcAlphaBlendFactor);
+		hash = Hash::combine(hash, attachment.dstAlphaBlendFactor);
+		hash = Hash::combine(hash, attachment.alphaBlendOp);
+		hash = Hash::combine(hash, attachment.colorWriteMask);
+	}
+	hash = Hash::bytes(key.dynamicStates.data(), key.dynamicStates.size() * sizeof(VkDynamicState), hash);
+	hash = Hash::bytes(key.colorFormats.data(), key.colorFormats.size() * sizeof(VkFormat), hash);
+	hash = Hash::combine(hash, key.depthFormat);
+	hash = Hash::combine(hash, key.renderPass);
+
+	hash = Hash::combine(hash, key.layout);
+	hash = Hash::combine(hash, key.subpass);
+	hash = Hash::combine(hash, key.flags);
+	hash = Hash::combine(hash, key.topology);
+	hash = Hash::combine(hash, key.polygonMode);
+	hash = Hash::combine(hash, key.cullMode);
+	hash = Hash::combine(hash, key.frontFace);
+	hash = Hash::combine(hash, key.rasterizationSamples);
+	hash = Hash::combine(hash, key.depthTest);
+	hash = Hash::combine(hash, key.depthWrite);
+	hash = Hash::combine(hash, key.depthCompareOp);
+	return static_cast<size_t>(hash);
+}
+
+
+PipelineRegistry::PipelineRegistry(PipelineCompiler& pipelineCompiler) : pipelineCompiler(pipelineCompiler) {
+}
+
+PipelineStateKey PipelineRegistry::makeKey(const GraphicsPipelineDesc& desc) {
+	PipelineStateKey key{};
+	for (const auto& descStage : desc.stages) {
+		PipelineStateKey::Stage stage{};
+		stage.stage = descStage.stage;
+		stage.module = descStage.module;
+		stage.entryPoint = descStage.entryPoint;
+
+		// keyed by what each constant is set to, not by the layout of the data, so the same values set in a different order still match
+		for (const auto& entry : descStage.specializationEntries) {
+			const uint8_t* value = descStage.specializationData.data() + entry.offset;
+			stage.constants.push_back({ entry.constantID, std::vector<uint8_t>(value, value + entry.size) });
+		}
+		std::sort(stage.constants.begin(), stage.constants.end());
+
+		key.stages.push_back(std::move(stage));
+	}
+
+	key.vertexBindings = desc.vertexBindings;
+	key.vertexAttributes = desc.vertexAttributes;
+	key.colorBlendAttachments = desc.colorBlendAttachments;
+	key.dynamicStates = desc.dynamicStates;
+
+	if (desc.colorFormats.empty() && desc.depthFormat == VK_FORMAT_UNDEFINED) {
+		key.renderPass = desc.renderPass; // no compatibility info, only share with the exact same render pass
+		key.depthFormat = VK_FORMAT_UNDEFINED;
+	}
+	else {
+		key.colorFormats = desc.colorFormats; // the sample count the attachments have to match is the key's rasterizationSamples
+		key.depthFormat = desc.depthFormat;
+		key.renderPass = VK_NULL_HANDLE;
+	}
+
+	key.layout = desc.layout;
+	key.subpass = desc.subpass;
+	key.flags = desc.flags;
+	key.topology = desc.topology;
+	key.polygonMode = desc.polygonMode;
+	key.cullMode = desc.cullMode;
+	key.frontFace = desc.frontFace;
+	key.rasterizationSamples = desc.rasterizationSamples;
+	key.depthTest = desc.depthTest;
+	key.depthWrite = desc.depthWrite;
+	key.depthCompareOp = desc.depthCompareOp;
+
+	return key;
+}
+
+PipelineHandle PipelineRegistry::getOrCreate(const GraphicsPipelineDesc& desc, VkPipeline fallback) {
+	PipelineStateKey key = makeKey(desc);
+
+	auto existing = pipelines.find(key);
+	if (existing != pipelines.end()) {
+		hitCount++;
+		return existing->second;
+	}
+
+	missCount++;
+	PipelineHandle handle = pipelineCompiler.submit(desc, fallback);
+	pipelines.emplace(key, handle);
+	descriptions.emplace(handle, desc);
+	return handle;
+}
+
+uint32_t PipelineRegistry::rebuildPipelinesUsing(VkShaderModule oldModule, VkShaderModule newModule) {
+	uint32_t rebuildCount = 0;
+
+	for (auto& entry : descriptions) {
+		GraphicsPipelineDesc& desc = entry.second;
+
+		bool usesModule = false;
+		for (auto& stage : desc.stages) {
+			if (stage.module == oldModule) {
+				stage.module = newModule;
+				usesModule = true;
+			}
+		}
+		if (!usesModule) {
+			continue;
+		}
+
+		// re-key the handle under its new state. If the new state matches another pipeline the two stay separate, merging handles that are already in use isn't worth it
+		auto oldKey = std::find_if(pipelines.begin(), pipelines.end(), [&entry](const auto& pipeline) { return pipeline.second == entry.first; });
+		if (oldKey != pipelines.end()) {
+			pipelines.erase(oldKey);
+		}
+		pipelines.emplace(makeKey(desc), entry.first);
+
+		pipelineCompiler.rebuild(entry.first, desc);
+		rebuildCount++;
+	}
+
+	return rebuildCount;
+}
+
+uint64_t PipelineRegistry::getHitCount() const {
+	return hitCount;
+}
+
+uint64_t PipelineRegistry::getMissCount() const {
+	return missCount;
+}
+
+size_t PipelineRegistry::size() const {
+	return pipelines.size();
+}
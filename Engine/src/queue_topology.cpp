@@ -0,0 +1,137 @@
+#pragma once
+
+#include "../headers/queue_topology.h"
+
+
+bool QueueTopology::isComplete() const {
+	return graphics.family != invalid && present.family != invalid;
+}
+
+bool QueueTopology::hasDedicatedCompute() const {
+	return compute.family != graphics.family;
+}
+
+bool QueueTopology::hasDedicatedTransfer() const {
+	return transfer.family != graphics.family;
+}
+
+QueueTopology QueueTopology::select(VkPhysicalDevice device, VkSurfaceKHR surface) {
+	QueueTopology topology;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	std::vector<VkBool32> canPresent(queueFamilyCount, VK_FALSE);
+	if (surface != VK_NULL_HANDLE) {
+		for (uint32_t family = 0; family < queueFamilyCount; family++) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, family, surface, &canPresent[family]);
+		}
+	}
+
+	// graphics: a family that can also present saves transferring swap chain images between families
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		if (!(queueFamilies[family].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			continue;
+		}
+		if (topology.graphics.family == invalid || (canPresent[family] && !canPresent[topology.graphics.family])) {
+			topology.graphics.family = family;
+		}
+	}
+	if (topology.graphics.family == invalid) {
+		return topology;
+	}
+
+	// compute: a family without graphics is a separate hardware queue that runs alongside rendering
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+			topology.compute.family = family;
+			break;
+		}
+	}
+	if (topology.compute.family == invalid) {
+		topology.compute.family = topology.graphics.family; // graphics families always support compute
+	}
+
+	// transfer: transfer-only first, then anything that isn't the graphics or compute family, then the compute family. Graphics and compute families can always transfer
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			topology.transfer.family = family;
+			break;
+		}
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && family != topology.graphics.family && family != topology.compute.family && topology.transfer.family == invalid) {
+			topology.transfer.family = family;
+		}
+	}
+	if (topology.transfer.family == invalid) {
+		topology.transfer.family = topology.compute.family;
+	}
+
+	// hand out queues in priority order. Graphics drives the frame rate, async compute feeds it, uploads can wait
+	auto assign = [&](Slot& slot, float priority) {
+		std::vector<float>& priorities = topology.queuePriorities[slot.family];
+		slot.priority = priority;
+		if (priorities.size() < queueFamilies[slot.family].queueCount) {
+			slot.index = static_cast<uint32_t>(priorities.size());
+			priorities.push_back(priority);
+		}
+		else {
+			slot.index = 0; // out of queues, share the family's first (highest priority) queue
+			slot.priority = priorities[0];
+		}
+	};
+
+	assign(topology.graphics, 1.0f);
+	assign(topology.compute, 0.75f);
+	assign(topology.transfer, 0.5f);
+
+	// present: the graphics queue if it can, otherwise the first family that can present. Headless mode has nothing to present, so it follows graphics
+	if (surface == VK_NULL_HANDLE || canPresent[topology.graphics.family]) {
+		topology.present = topology.graphics;
+	}
+	else {
+		for (uint32_t family = 0; family < queueFamilyCount; family++) {
+			if (canPresent[family]) {
+				topology.present.family = family;
+				topology.presentRecordsCommands = (queueFamilies[family].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT)) != 0;
+				if (topology.queuePriorities.count(family) != 0) {
+					topology.present.index = 0; // present is cheap, share the family's first queue
+					topology.present.priority = topology.queuePriorities[family][0];
+				}
+				else {
+					assign(topology.present, 1.0f);
+				}
+				break;
+			}
+		}
+	}
+
+	return topology;
+}
+
+std::vector<VkDeviceQueueCreateInfo> QueueTopology::queueCreateInfos() const {
+	std::vector<VkDeviceQueueCreateInfo> createInfos;
+	for (const auto& family : queuePriorities) {
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = family.first;
+		queueCreateInfo.queueCount = static_cast<uint32_t>(family.second.size());
+		queueCreateInfo.pQueuePriorities = family.second.data(); // influences how the driver schedules the family's queues against each other
+		createInfos.push_back(queueCreateInfo);
+	}
+	return createInfos;
+}
+
+
+DeviceQueues DeviceQueues::get(VkDevice logicalDevice, const QueueTopology& topology) {
+	DeviceQueues queues;
+	vkGetDeviceQueue(logicalDevice, topology.graphics.family, topology.graphics.index, &queues.graphics);
+	vkGetDeviceQueue(logicalDevice, topology.present.family, topology.present.index, &queues.present);
+	vkGetDeviceQueue(logicalDevice, topology.compute.family, topology.compute.index, &queues.compute);
+	vkGetDeviceQueue(logicalDevice, topology.transfer.family, topology.transfer.index, &queues.transfer);
+	return queues;
+}
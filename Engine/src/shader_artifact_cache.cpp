@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../headers/shader_artifact_cache.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+
+ShaderArtifactCache::ShaderArtifactCache(const std::string& cacheDirectory) {
+	this->cacheDirectory = cacheDirectory;
+}
+
+std::string ShaderArtifactCache::artifactPath(uint64_t key) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(cacheDirectory) / name).string();
+}
+
+bool ShaderArtifactCache::load(uint64_t key, std::vector<uint32_t>& code) const {
+	std::ifstream file(artifactPath(key), std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0) {
+		return false; // truncated, produce it again and overwrite it
+	}
+
+	code.resize(fileSize / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(code.data()), fileSize);
+
+	return file.good() && code[0] == 0x07230203; // SPIR-V magic number
+}
+
+void ShaderArtifactCache::store(uint64_t key, const std::vector<uint32_t>& code) const {
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	// several workers can produce the same artifact at once, so each writes its own temporary file and the rename makes the last one win in one step
+	std::filesystem::path path = artifactPath(key);
+	std::filesystem::path tempPath = path;
+	tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t));
+		if (!file.good()) {
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+	}
+}
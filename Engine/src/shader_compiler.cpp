@@ -0,0 +1,132 @@
+#pragma once
+
+#include "../headers/shader_compiler.h"
+#include "../headers/hash.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static constexpr uint32_t artifactFormatVersion = 2; // bump when the way artifacts are produced changes, so stale ones are ignored
+
+
+uint64_t ShaderCompileOptions::hash() const {
+	uint64_t hash = Hash::offsetBasis;
+	for (const auto& define : defines) {
+		hash = Hash::string(define.first, hash);
+		hash = Hash::combine(hash, '=');
+		hash = Hash::string(define.second, hash);
+		hash = Hash::combine(hash, ';');
+	}
+	hash = Hash::combine(hash, static_cast<uint32_t>(optimization));
+	hash = Hash::combine(hash, debugInfo);
+	hash = Hash::combine(hash, targetVulkanVersion);
+	return hash;
+}
+
+
+ShaderCompiler::ShaderCompiler(ThreadPool& threadPool, const std::string& cacheDirectory) : threadPool(threadPool), artifacts(cacheDirectory) {
+	if (!compiler.IsValid()) {
+		throw std::runtime_error("failed to initialize shader compiler!");
+	}
+}
+
+std::vector<uint32_t> ShaderCompiler::compile(const std::string& sourcePath, VkShaderStageFlagBits stage, const ShaderCompileOptions& options) {
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open shader source: " + sourcePath);
+	}
+	std::stringstream source;
+	source << file.rdbuf();
+	std::string sourceText = source.str();
+
+	uint64_t key = Hash::string(sourceText);
+	key = Hash::combine(key, stage);
+	key = Hash::combine(key, options.hash());
+	key = Hash::combine(key, artifactFormatVersion);
+	key = Hash::combine(key, ShaderOptimizer::isAvailable()); // shaderc's passes and spirv-tools' don't produce the same code
+
+	std::vector<uint32_t> code;
+	if (artifacts.load(key, code)) {
+		cacheHits++;
+		return code;
+	}
+	cacheMisses++;
+
+	shaderc_shader_kind kind;
+	switch (stage) {
+	case VK_SHADER_STAGE_VERTEX_BIT: kind = shaderc_vertex_shader; break;
+	case VK_SHADER_STAGE_FRAGMENT_BIT: kind = shaderc_fragment_shader; break;
+	case VK_SHADER_STAGE_COMPUTE_BIT: kind = shaderc_compute_shader; break;
+	case VK_SHADER_STAGE_GEOMETRY_BIT: kind = shaderc_geometry_shader; break;
+	case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: kind = shaderc_tess_control_shader; break;
+	case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: kind = shaderc_tess_evaluation_shader; break;
+	case VK_SHADER_STAGE_TASK_BIT_EXT: kind = shaderc_task_shader; break;
+	case VK_SHADER_STAGE_MESH_BIT_EXT: kind = shaderc_mesh_shader; break;
+	default: throw std::runtime_error("unsupported shader stage: " + sourcePath);
+	}
+
+	shaderc::CompileOptions compileOptions;
+	for (const auto& define : options.defines) {
+		compileOptions.AddMacroDefinition(define.first, define.second);
+	}
+	// optimization is done below, with the same passes used for offline compiled SPIR-V. Without the spirv-tools optimizer shaderc runs its own
+	bool optimizeAfterwards = ShaderOptimizer::isAvailable();
+	switch (optimizeAfterwards ? ShaderOptimization::None : options.optimization) {
+	case ShaderOptimization::Performance: compileOptions.SetOptimizationLevel(shaderc_optimization_level_performance); break;
+	case ShaderOptimization::Size: compileOptions.SetOptimizationLevel(shaderc_optimization_level_size); break;
+	case ShaderOptimization::None: compileOptions.SetOptimizationLevel(shaderc_optimization_level_zero); break;
+	}
+	if (options.debugInfo) {
+		compileOptions.SetGenerateDebugInfo();
+	}
+	compileOptions.SetTargetEnvironment(shaderc_target_env_vulkan, options.targetVulkanVersion);
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(sourceText, kind, sourcePath.c_str(), compileOptions);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		throw std::runtime_error("failed to compile shader " + sourcePath + ":\n" + result.GetErrorMessage());
+	}
+
+	code.assign(result.cbegin(), result.cend());
+
+	ShaderOptimizer optimizer({ options.optimization, !options.debugInfo, options.targetVulkanVersion });
+	if (optimizeAfterwards && optimizer.getSettings().isEnabled()) {
+		code = optimizer.optimize(code.data(), code.size() * sizeof(uint32_t));
+	}
+
+	artifacts.store(key, code);
+	return code;
+}
+
+std::future<std::vector<uint32_t>> ShaderCompiler::compileAsync(const std::string& sourcePath, VkShaderStageFlagBits stage, const ShaderCompileOptions& options) {
+	return threadPool.submit([this, sourcePath, stage, options]() {
+		return compile(sourcePath, stage, options);
+	});
+}
+
+VkShaderStageFlagBits ShaderCompiler::stageFromPath(const std::string& sourcePath) {
+	std::string extension = std::filesystem::path(sourcePath).extension().string();
+	if (extension == ".vert") return VK_SHADER_STAGE_VERTEX_BIT;
+	if (extension == ".frag") return VK_SHADER_STAGE_FRAGMENT_BIT;
+	if (extension == ".comp") return VK_SHADER_STAGE_COMPUTE_BIT;
+	if (extension == ".geom") return VK_SHADER_STAGE_GEOMETRY_BIT;
+	if (extension == ".tesc") return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+	if (extension == ".tese") return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	if (extension == ".task") return VK_SHADER_STAGE_TASK_BIT_EXT;
+	if (extension == ".mesh") return VK_SHADER_STAGE_MESH_BIT_EXT;
+	throw std::runtime_error("unknown shader stage for " + sourcePath);
+}
+
+bool ShaderCompiler::isSourcePath(const std::string& path) {
+	std::string extension = std::filesystem::path(path).extension().string();
+	return extension == ".vert" || extension == ".frag" || extension == ".comp" || extension == ".geom" || extension == ".tesc" || extension == ".tese"
+		|| extension == ".task" || extension == ".mesh";
+}
+
+uint64_t ShaderCompiler::getCacheHits() const {
+	return cacheHits;
+}
+
+uint64_t ShaderCompiler::getCacheMisses() const {
+	return cacheMisses;
+}
@@ -1,29 +1,272 @@
 #pragma once
 
 #include "../headers/shader_manager.h"
+#include "../headers/hash.h"
+#include "../headers/mapped_file.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan.h>
 
+static constexpr uint32_t spirvMagic = 0x07230203; // first word of every SPIR-V module
+
 
 ShaderManager::ShaderManager(VkDevice &logicalDevice) {
 	this->logicalDevice = logicalDevice;
 }
 
-VkShaderModule ShaderManager::createShaderModule(const std::vector<char>& code) {
+VkShaderModule ShaderManager::loadShaderModule(const std::string& filename) {
+	auto loaded = modulesByPath.find(filename);
+	if (loaded != modulesByPath.end()) {
+		cacheHits++;
+		return loaded->second;
+	}
+
+	MappedFile file(filename); // page aligned, so the data can be read as 32-bit words in place
+	if (file.getSize() < sizeof(uint32_t) || file.getSize() % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("not a SPIR-V file: " + filename);
+	}
+
+	const uint32_t* code = static_cast<const uint32_t*>(file.getData());
+	if (code[0] != spirvMagic) {
+		throw std::runtime_error("not a SPIR-V file: " + filename);
+	}
+
+	if (optimizer) {
+		std::vector<uint32_t> optimized = optimizeCode(code, file.getSize());
+		VkShaderModule shaderModule = createShaderModule(optimized.data(), optimized.size() * sizeof(uint32_t));
+		modulesByPath[filename] = shaderModule;
+		return shaderModule;
+	}
+
+	VkShaderModule shaderModule = createShaderModule(code, file.getSize());
+	modulesByPath[filename] = shaderModule;
+	return shaderModule;
+}
+
+std::vector<uint32_t> ShaderManager::optimizeCode(const uint32_t* code, size_t codeSize) {
+	uint64_t key = Hash::combine(hashCode(code, codeSize), optimizer->getSettings().hash());
+
+	std::vector<uint32_t> optimized;
+	if (optimizedArtifacts->load(key, optimized)) {
+		return optimized;
+	}
+
+	optimized = optimizer->optimize(code, codeSize);
+	optimizedArtifacts->store(key, optimized);
+	return optimized;
+}
+
+VkShaderModule ShaderManager::getLoadedModule(const std::string& filename) const {
+	auto loaded = modulesByPath.find(filename);
+	if (loaded == modulesByPath.end()) {
+		return VK_NULL_HANDLE;
+	}
+	return loaded->second;
+}
+
+VkShaderModule ShaderManager::reloadShaderModule(const std::string& filename) {
+	auto loaded = modulesByPath.find(filename);
+	if (loaded == modulesByPath.end()) {
+		return loadShaderModule(filename);
+	}
+
+	VkShaderModule previousModule = loaded->second;
+	modulesByPath.erase(loaded); // forget what was loaded so the file is read again
+
+	try {
+		VkShaderModule shaderModule = loadShaderModule(filename);
+		if (shaderModule != previousModule) {
+			releaseIfUnused(previousModule);
+		}
+		return shaderModule;
+	}
+	catch (...) {
+		modulesByPath[filename] = previousModule; // keep the last good module so a later fix is still picked up as a reload
+		throw;
+	}
+}
+
+VkShaderModule ShaderManager::createShaderModule(const uint32_t* code, size_t codeSize) {
+	Hash::Wide hash = Hash::wideBytes(code, codeSize);
+	std::vector<CachedModule>& cached = modulesByHash[hash.low];
+	for (const auto& entry : cached) {
+		if (entry.codeSize == codeSize && entry.hashHigh == hash.high) {
+			cacheHits++;
+			return entry.module;
+		}
+	}
+
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	createInfo.codeSize = codeSize; // in bytes
+	createInfo.pCode = code;
 
 	VkShaderModule shaderModule;
 	if (vkCreateShaderModule(logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create shader module!");
 	}
 
+	cached.push_back({ shaderModule, codeSize, hash.high });
+	reflections[shaderModule] = ShaderReflection::reflect(code, codeSize); // while the code is at hand, the mapping or buffer is gone afterwards
+	return shaderModule;
+}
+
+const ShaderReflection& ShaderManager::getReflection(VkShaderModule shaderModule) const {
+	auto reflection = reflections.find(shaderModule);
+	if (reflection == reflections.end()) {
+		throw std::runtime_error("shader module was not created by this shader manager!");
+	}
+	return reflection->second;
+}
+
+VkShaderModule ShaderManager::createShaderModule(const std::vector<char>& code) {
+	if (code.empty() || code.size() % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("SPIR-V code size must be a non-zero multiple of 4 bytes!");
+	}
+
+	// a std::vector<char> is only guaranteed to be aligned for char, so copy into words before handing it to the driver
+	std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+	std::memcpy(words.data(), code.data(), code.size());
+	return createShaderModule(words.data(), code.size());
+}
+
+void ShaderManager::enableOptimization(const ShaderOptimizerSettings& settings, const std::string& cacheDirectory) {
+	optimizer = std::make_unique<ShaderOptimizer>(settings);
+	optimizedArtifacts = std::make_unique<ShaderArtifactCache>(cacheDirectory);
+}
+
+void ShaderManager::enableRuntimeCompilation(ThreadPool& threadPool, const std::string& cacheDirectory) {
+	compiler = std::make_unique<ShaderCompiler>(threadPool, cacheDirectory);
+}
+
+bool ShaderManager::canCompileGLSL() const {
+	return compiler != nullptr;
+}
+
+int ShaderManager::findCompiledSource(const std::string& sourcePath, uint64_t optionsHash) const {
+	for (size_t i = 0; i < compiledSources.size(); i++) {
+		if (compiledSources[i].optionsHash == optionsHash && compiledSources[i].sourcePath == sourcePath) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+VkShaderModule ShaderManager::loadGLSLModule(const std::string& sourcePath, const ShaderCompileOptions& options) {
+	return loadGLSLModules({ { sourcePath, options } })[0];
+}
+
+std::vector<VkShaderModule> ShaderManager::loadGLSLModules(const std::vector<GLSLRequest>& requests) {
+	if (!compiler) {
+		throw std::runtime_error("runtime shader compilation is not enabled!");
+	}
+
+	std::vector<VkShaderModule> modules(requests.size(), VK_NULL_HANDLE);
+	std::vector<std::future<std::vector<uint32_t>>> pending(requests.size());
+
+	// start every compile that isn't already loaded before waiting on any of them
+	for (size_t i = 0; i < requests.size(); i++) {
+		int loaded = findCompiledSource(requests[i].sourcePath, requests[i].options.hash());
+		if (loaded >= 0) {
+			cacheHits++;
+			modules[i] = compiledSources[loaded].module;
+			continue;
+		}
+		pending[i] = compiler->compileAsync(requests[i].sourcePath, ShaderCompiler::stageFromPath(requests[i].sourcePath), requests[i].options);
+	}
+
+	// modules are created here on the calling thread, so the caches are never touched by workers
+	for (size_t i = 0; i < requests.size(); i++) {
+		if (modules[i] != VK_NULL_HANDLE) {
+			continue;
+		}
+
+		int loaded = findCompiledSource(requests[i].sourcePath, requests[i].options.hash());
+		std::vector<uint32_t> code = pending[i].get(); // always consume the future, a duplicate request in the same batch still had its compile started
+
+		if (loaded >= 0) { // the same source and options appeared earlier in the batch
+			modules[i] = compiledSources[loaded].module;
+			continue;
+		}
+
+		modules[i] = createShaderModule(code.data(), code.size() * sizeof(uint32_t));
+		compiledSources.push_back({ requests[i].sourcePath, ShaderCompiler::stageFromPath(requests[i].sourcePath), requests[i].options, requests[i].options.hash(), modules[i] });
+	}
+
+	return modules;
+}
+
+std::vector<ShaderManager::GLSLReload> ShaderManager::recompileGLSLAsync(const std::string& sourcePath) {
+	std::vector<GLSLReload> reloads;
+	if (!compiler) {
+		return reloads;
+	}
+
+	for (size_t i = 0; i < compiledSources.size(); i++) {
+		CompiledSource& source = compiledSources[i];
+		if (source.sourcePath != sourcePath) {
+			continue;
+		}
+		reloads.push_back({ i, ++source.reloadCount, compiler->compileAsync(source.sourcePath, source.stage, source.options) });
+	}
+	return reloads;
+}
+
+VkShaderModule ShaderManager::finishGLSLReload(GLSLReload& reload, VkShaderModule& previousModule) {
+	previousModule = compiledSources[reload.sourceIndex].module;
+	if (reload.reload != compiledSources[reload.sourceIndex].reloadCount) { // a later save is being compiled, its result wins whichever finishes first
+		reload.code.wait();
+		return VK_NULL_HANDLE;
+	}
+
+	std::vector<uint32_t> code = reload.code.get();
+
+	VkShaderModule shaderModule = createShaderModule(code.data(), code.size() * sizeof(uint32_t));
+	compiledSources[reload.sourceIndex].module = shaderModule;
+	if (shaderModule != previousModule) {
+		releaseIfUnused(previousModule);
+	}
 	return shaderModule;
 }
 
+void ShaderManager::releaseIfUnused(VkShaderModule shaderModule) {
+	for (const auto& loaded : modulesByPath) {
+		if (loaded.second == shaderModule) {
+			return;
+		}
+	}
+	for (const auto& source : compiledSources) {
+		if (source.module == shaderModule) {
+			return;
+		}
+	}
+
+	for (auto bucket = modulesByHash.begin(); bucket != modulesByHash.end(); ++bucket) {
+		auto& entries = bucket->second;
+		auto entry = std::find_if(entries.begin(), entries.end(), [shaderModule](const CachedModule& cached) { return cached.module == shaderModule; });
+		if (entry != entries.end()) {
+			entries.erase(entry);
+			if (entries.empty()) {
+				modulesByHash.erase(bucket);
+			}
+			break;
+		}
+	}
+	supersededModules.push_back(shaderModule); // the reflection stays until the module is taken, a rebuild may still be reading it
+}
+
+std::vector<VkShaderModule> ShaderManager::takeSupersededModules() {
+	for (VkShaderModule shaderModule : supersededModules) {
+		reflections.erase(shaderModule);
+	}
+	std::vector<VkShaderModule> modules;
+	modules.swap(supersededModules);
+	return modules;
+}
+
 std::vector<char> ShaderManager::readFile(const std::string& filename) {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary); // check two flags: ate - start reading at the end of the file, binary - read the file as binary
 	if (!file.is_open()) {
@@ -39,4 +282,30 @@ std::vector<char> ShaderManager::readFile(const std::string& filename) {
 	file.close();
 
 	return buffer;
-}
\ No newline at end of file
+}
+
+uint64_t ShaderManager::hashCode(const uint32_t* code, size_t codeSize) {
+	return Hash::bytes(code, codeSize);
+}
+
+uint64_t ShaderManager::getCacheHits() const {
+	return cacheHits;
+}
+
+size_t ShaderManager::size() const {
+	return reflections.size(); // one per module
+}
+
+void ShaderManager::destroy() {
+	for (auto& entry : reflections) {
+		vkDestroyShaderModule(logicalDevice, entry.first, nullptr); // includes superseded modules that were never taken
+	}
+	supersededModules.clear();
+	modulesByHash.clear();
+	modulesByPath.clear();
+	reflections.clear();
+	compiledSources.clear();
+	compiler.reset();
+	optimizer.reset();
+	optimizedArtifacts.reset();
+}
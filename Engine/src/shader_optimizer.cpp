@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../headers/shader_optimizer.h"
+#include "../headers/hash.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#ifdef SPIRV_TOOLS_OPTIMIZER
+#include <spirv-tools/optimizer.hpp>
+#endif
+
+
+bool ShaderOptimizerSettings::isEnabled() const {
+	return level != ShaderOptimization::None || stripDebugInfo;
+}
+
+uint64_t ShaderOptimizerSettings::hash() const {
+	uint64_t hash = Hash::combine(Hash::offsetBasis, static_cast<uint32_t>(level));
+	hash = Hash::combine(hash, stripDebugInfo);
+	hash = Hash::combine(hash, targetVulkanVersion);
+	return hash;
+}
+
+
+ShaderOptimizer::ShaderOptimizer(const ShaderOptimizerSettings& settings) {
+	this->settings = settings;
+}
+
+bool ShaderOptimizer::isAvailable() {
+#ifdef SPIRV_TOOLS_OPTIMIZER
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::vector<uint32_t> ShaderOptimizer::optimize(const uint32_t* code, size_t codeSize) const {
+#ifndef SPIRV_TOOLS_OPTIMIZER
+	(void)code;
+	(void)codeSize;
+	throw std::runtime_error("failed to optimize shader, this build has no spirv-tools optimizer!");
+#else
+	// a module built for a newer SPIR-V version than the target accepts (mesh shaders need 1.4) was compiled for a newer Vulkan, and is optimized for that one
+	uint32_t vulkanVersion = settings.targetVulkanVersion;
+	uint32_t spirvVersion = codeSize >= 2 * sizeof(uint32_t) ? code[1] : 0;
+	if (spirvVersion >= 0x00010600) vulkanVersion = std::max(vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_3));
+	else if (spirvVersion >= 0x00010400) vulkanVersion = std::max(vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_2));
+	else if (spirvVersion >= 0x00010300) vulkanVersion = std::max(vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_1));
+
+	spv_target_env environment;
+	if (vulkanVersion >= VK_API_VERSION_1_3) environment = SPV_ENV_VULKAN_1_3;
+	else if (vulkanVersion >= VK_API_VERSION_1_2) environment = SPV_ENV_VULKAN_1_2;
+	else if (vulkanVersion >= VK_API_VERSION_1_1) environment = SPV_ENV_VULKAN_1_1;
+	else environment = SPV_ENV_VULKAN_1_0;
+
+	spvtools::Optimizer optimizer(environment);
+
+	std::string messages;
+	optimizer.SetMessageConsumer([&messages](spv_message_level_t level, const char*, const spv_position_t&, const char* message) {
+		if (level <= SPV_MSG_ERROR) {
+			messages += message;
+			messages += "\n";
+		}
+	});
+
+	// debug info goes first so the other passes don't spend time keeping it up to date
+	if (settings.stripDebugInfo) {
+		optimizer.RegisterPass(spvtools::CreateStripDebugInfoPass());
+		optimizer.RegisterPass(spvtools::CreateStripNonSemanticInfoPass());
+	}
+
+	switch (settings.level) {
+	case ShaderOptimization::Performance: optimizer.RegisterPerformancePasses(true); break; // preserve the interface, unused inputs and bindings stay declared
+	case ShaderOptimization::Size: optimizer.RegisterSizePasses(true); break;
+	case ShaderOptimization::None: break;
+	}
+
+	std::vector<uint32_t> optimized;
+	if (!optimizer.Run(code, codeSize / sizeof(uint32_t), &optimized)) {
+		throw std::runtime_error("failed to optimize shader:\n" + messages);
+	}
+	return optimized;
+#endif
+}
+
+const ShaderOptimizerSettings& ShaderOptimizer::getSettings() const {
+	return settings;
+}
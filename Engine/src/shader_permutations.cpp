@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../headers/shader_permutations.h"
+#include <stdexcept>
+
+
+ShaderPermutationSet::ShaderPermutationSet(PipelineRegistry& pipelineRegistry, const ShaderManager& shaderManager, const GraphicsPipelineDesc& baseDesc, const std::vector<Feature>& features)
+	: pipelineRegistry(pipelineRegistry), shaderManager(shaderManager) {
+	if (features.size() > 64) {
+		throw std::runtime_error("too many shader features, a feature mask holds 64!");
+	}
+
+	this->baseDesc = baseDesc;
+	this->features = features;
+}
+
+uint64_t ShaderPermutationSet::getFeatureMask(const std::vector<std::string>& enabledFeatures) const {
+	uint64_t mask = 0;
+	for (const auto& name : enabledFeatures) {
+		size_t i = 0;
+		while (i < features.size() && features[i].name != name) {
+			i++;
+		}
+		if (i == features.size()) {
+			throw std::runtime_error("unknown shader feature: " + name);
+		}
+		mask |= 1ull << i;
+	}
+	return mask;
+}
+
+uint64_t ShaderPermutationSet::effectiveMask(uint64_t featureMask) const {
+	uint64_t mask = 0;
+	for (size_t i = 0; i < features.size(); i++) {
+		if ((featureMask & (1ull << i)) == 0) {
+			continue;
+		}
+		for (const auto& stage : baseDesc.stages) {
+			if (shaderManager.getReflection(stage.module).hasSpecializationConstant(features[i].constantId)) {
+				mask |= 1ull << i;
+				break;
+			}
+		}
+	}
+	return mask;
+}
+
+PipelineHandle ShaderPermutationSet::getVariant(uint64_t featureMask) {
+	uint64_t mask = effectiveMask(featureMask);
+
+	auto variant = variants.find(mask);
+	if (variant != variants.end()) {
+		return variant->second;
+	}
+
+	PipelineHandle handle = pipelineRegistry.getOrCreate(makeVariantDesc(mask));
+	variants.emplace(mask, handle);
+	return handle;
+}
+
+PipelineHandle ShaderPermutationSet::getVariant(const std::vector<std::string>& enabledFeatures) {
+	return getVariant(getFeatureMask(enabledFeatures));
+}
+
+GraphicsPipelineDesc ShaderPermutationSet::makeVariantDesc(uint64_t featureMask) const {
+	GraphicsPipelineDesc desc = baseDesc;
+	for (auto& stage : desc.stages) {
+		const ShaderReflection& reflection = shaderManager.getReflection(stage.module);
+		for (size_t i = 0; i < features.size(); i++) {
+			if (reflection.hasSpecializationConstant(features[i].constantId)) {
+				stage.setSpecializationConstant(features[i].constantId, (featureMask & (1ull << i)) ? VK_TRUE : VK_FALSE); // every declared feature is set, so the key doesn't depend on shader defaults
+			}
+		}
+	}
+	return desc;
+}
+
+void ShaderPermutationSet::replaceModule(VkShaderModule oldModule, VkShaderModule newModule) {
+	bool replaced = false;
+	for (auto& stage : baseDesc.stages) {
+		if (stage.module == oldModule) {
+			stage.module = newModule;
+			replaced = true;
+		}
+	}
+
+	// the new module may declare different constants, so the mask to pipeline mapping has to be worked out again
+	if (replaced) {
+		variants.clear();
+	}
+}
+
+size_t ShaderPermutationSet::size() const {
+	return variants.size();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "../headers/shader_reflection.h"
+#include <algorithm>
+#include <stdexcept>
+#include <spirv_cross/spirv_cross.hpp>
+
+static VkShaderStageFlagBits stageFromExecutionModel(spv::ExecutionModel model) {
+	switch (model) {
+	case spv::ExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+	case spv::ExecutionModelTessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+	case spv::ExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	case spv::ExecutionModelGeometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+	case spv::ExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+	case spv::ExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+	case spv::ExecutionModelTaskEXT: return VK_SHADER_STAGE_TASK_BIT_EXT;
+	case spv::ExecutionModelMeshEXT: return VK_SHADER_STAGE_MESH_BIT_EXT;
+	default: return VK_SHADER_STAGE_ALL;
+	}
+}
+
+// 32-bit vertex format for a scalar or vector shader input
+static VkFormat vertexFormat(const spirv_cross::SPIRType& type) {
+	static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+	static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+	static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+	if (type.vecsize < 1 || type.vecsize > 4 || type.columns != 1) {
+		throw std::runtime_error("unsupported vertex input type!");
+	}
+
+	switch (type.basetype) {
+	case spirv_cross::SPIRType::Float: return floatFormats[type.vecsize - 1];
+	case spirv_cross::SPIRType::Int: return intFormats[type.vecsize - 1];
+	case spirv_cross::SPIRType::UInt: return uintFormats[type.vecsize - 1];
+	default: throw std::runtime_error("unsupported vertex input type!");
+	}
+}
+
+ShaderReflection ShaderReflection::reflect(const uint32_t* code, size_t codeSize) {
+	spirv_cross::Compiler compiler(code, codeSize / sizeof(uint32_t));
+	spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+	ShaderReflection reflection;
+	reflection.stage = stageFromExecutionModel(compiler.get_execution_model());
+
+	auto addBindings = [&](const spirv_cross::SmallVector<spirv_cross::Resource>& list, VkDescriptorType type) {
+		for (const auto& resource : list) {
+			const spirv_cross::SPIRType& resourceType = compiler.get_type(resource.type_id);
+
+			DescriptorBinding binding{};
+			binding.set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+			binding.binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+			binding.type = type;
+			binding.count = 1; // every dimension of a multi-dimensional array is flattened into the binding, SPIRV-Cross lists them innermost first
+			for (uint32_t dimension : resourceType.array) {
+				binding.count *= dimension; // a runtime sized dimension is 0, which makes the whole count 0
+			}
+			reflection.bindings.push_back(binding);
+		}
+	};
+
+	addBindings(resources.uniform_buffers, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+	addBindings(resources.storage_buffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	addBindings(resources.sampled_images, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	addBindings(resources.separate_images, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+	addBindings(resources.separate_samplers, VK_DESCRIPTOR_TYPE_SAMPLER);
+	addBindings(resources.storage_images, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	addBindings(resources.subpass_inputs, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+
+	if (!resources.push_constant_buffers.empty()) {
+		const auto& block = resources.push_constant_buffers[0]; // there can only be one per stage
+		const spirv_cross::SPIRType& blockType = compiler.get_type(block.base_type_id);
+
+		uint32_t size = static_cast<uint32_t>(compiler.get_declared_struct_size(blockType));
+		uint32_t offset = size;
+		for (uint32_t i = 0; i < blockType.member_types.size(); i++) {
+			offset = std::min(offset, compiler.type_struct_member_offset(blockType, i)); // layout(offset = N) lets stages share one block at different offsets
+		}
+
+		reflection.pushConstantOffset = offset;
+		reflection.pushConstantSize = size - offset;
+	}
+
+	for (const auto& constant : compiler.get_specialization_constants()) {
+		reflection.specializationConstants.push_back({ constant.constant_id, compiler.get_name(constant.id) });
+	}
+
+	if (reflection.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+		for (const auto& input : resources.stage_inputs) {
+			VertexInput vertexInput{};
+			vertexInput.location = compiler.get_decoration(input.id, spv::DecorationLocation);
+			vertexInput.format = vertexFormat(compiler.get_type(input.type_id));
+			reflection.vertexInputs.push_back(vertexInput);
+		}
+		std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const VertexInput& a, const VertexInput& b) { return a.location < b.location; });
+	}
+
+	return reflection;
+}
+
+bool ShaderReflection::hasSpecializationConstant(uint32_t constantId) const {
+	for (const auto& constant : specializationConstants) {
+		if (constant.constantId == constantId) {
+			return true;
+		}
+	}
+	return false;
+}
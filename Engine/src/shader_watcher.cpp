@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../headers/shader_watcher.h"
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+ShaderWatcher::ShaderWatcher(const std::string& directory) {
+	this->directory = directory;
+	running = true;
+	watchThread = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+	running = false;
+	if (watchThread.joinable()) {
+		watchThread.join();
+	}
+}
+
+void ShaderWatcher::recordChange(const std::string& path) {
+	std::lock_guard<std::mutex> lock(changesMutex);
+	changedPaths.insert(path);
+}
+
+std::vector<std::string> ShaderWatcher::pollChanges() {
+	std::lock_guard<std::mutex> lock(changesMutex);
+	std::vector<std::string> changes(changedPaths.begin(), changedPaths.end());
+	changedPaths.clear();
+	return changes;
+}
+
+#ifdef __linux__
+void ShaderWatcher::watchLoop() {
+	int inotifyFd = inotify_init1(IN_NONBLOCK);
+	if (inotifyFd < 0) {
+		return; // hot reload is a convenience, run without it rather than failing
+	}
+
+	// IN_CLOSE_WRITE catches compilers writing the file in place, IN_MOVED_TO catches editors that save to a temporary file and rename it
+	if (inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(inotifyFd);
+		return;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+
+	while (running) {
+		pollfd pollFd{};
+		pollFd.fd = inotifyFd;
+		pollFd.events = POLLIN;
+
+		if (poll(&pollFd, 1, 100) <= 0) { // time out regularly to notice when the watcher is being shut down
+			continue;
+		}
+
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length;) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			if (event->len > 0) {
+				recordChange((std::filesystem::path(directory) / event->name).generic_string());
+			}
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+
+	close(inotifyFd);
+}
+#else
+void ShaderWatcher::watchLoop() {
+	std::map<std::string, std::filesystem::file_time_type> writeTimes;
+	bool firstScan = true; // the first scan only records the current state
+
+	while (running) {
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (!entry.is_regular_file(error)) {
+				continue;
+			}
+
+			std::string path = entry.path().generic_string();
+			auto writeTime = entry.last_write_time(error);
+			auto known = writeTimes.find(path);
+
+			if (known == writeTimes.end() || known->second != writeTime) {
+				writeTimes[path] = writeTime;
+				if (!firstScan) {
+					recordChange(path);
+				}
+			}
+		}
+		firstScan = false;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	}
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../headers/thread_pool.h"
+
+static thread_local int workerIndex = -1;
+
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, static_cast<int>(i));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop(int index) {
+	workerIndex = index;
+
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping && tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task(); // packaged tasks capture their own exceptions, so nothing escapes here
+	}
+}
+
+uint32_t ThreadPool::size() const {
+	return static_cast<uint32_t>(workers.size());
+}
+
+int ThreadPool::currentWorkerIndex() {
+	return workerIndex;
+}
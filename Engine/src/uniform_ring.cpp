@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../headers/uniform_ring.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+UniformRing::UniformRing(VkDevice& logicalDevice, GpuAllocator& gpuAllocator, VkPhysicalDevice physicalDevice, VkDeviceSize bytesPerFrame, uint32_t framesInFlight)
+	: gpuAllocator(gpuAllocator) {
+	this->logicalDevice = logicalDevice;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+	regionSize = (bytesPerFrame + alignment - 1) / alignment * alignment;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = regionSize * framesInFlight;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create uniform ring buffer!");
+	}
+
+	memory = gpuAllocator.allocateBuffer(buffer, MemoryUsage::Upload); // read straight from host visible memory, there's no staging copy to pay for
+	stats.bytesPerFrame = regionSize;
+}
+
+void UniformRing::beginFrame(uint32_t frame) {
+	regionBegin = regionSize * frame;
+	head = regionBegin;
+}
+
+UniformRing::Slice UniformRing::allocate(VkDeviceSize size) {
+	VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+	if (offset + size > regionBegin + regionSize) {
+		throw std::runtime_error("uniform ring is out of space for this frame!");
+	}
+	head = offset + size;
+
+	stats.peakFrameBytes = std::max(stats.peakFrameBytes, head - regionBegin);
+	stats.slicesAllocated++;
+	return { static_cast<uint32_t>(offset), static_cast<uint8_t*>(memory.mapped) + offset };
+}
+
+void UniformRing::flush() {
+	if (head > regionBegin) {
+		gpuAllocator.flush(memory, regionBegin, head - regionBegin);
+	}
+}
+
+VkBuffer UniformRing::getBuffer() const {
+	return buffer;
+}
+
+const UniformRing::Stats& UniformRing::getStats() const {
+	return stats;
+}
+
+void UniformRing::destroy() {
+	if (buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(logicalDevice, buffer, nullptr);
+		gpuAllocator.free(memory);
+		buffer = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include "../headers/upload_manager.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+bool UploadHandoff::empty() const {
+	return semaphores.empty();
+}
+
+
+UploadManager::UploadManager(VkDevice& logicalDevice, GpuAllocator& gpuAllocator, uint32_t transferFamily, VkQueue transferQueue, uint32_t graphicsFamily, VkDeviceSize ringSize)
+	: gpuAllocator(gpuAllocator) {
+	this->logicalDevice = logicalDevice;
+	this->transferFamily = transferFamily;
+	this->transferQueue = transferQueue;
+	this->graphicsFamily = graphicsFamily;
+	this->ringSize = ringSize;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // batches are recycled one at a time
+	poolInfo.queueFamilyIndex = transferFamily;
+
+	if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = ringSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // only ever read by the transfer queue
+
+	if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create staging buffer!");
+	}
+
+	stagingMemory = gpuAllocator.allocateBuffer(stagingBuffer, MemoryUsage::Upload);
+}
+
+bool UploadManager::tryReserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+	if (ringUsed == 0) { // nothing in flight, start over at the beginning so large uploads have the whole ring
+		ringHead = 0;
+		ringTail = 0;
+	}
+	else if (ringHead == ringTail) {
+		return false; // completely full
+	}
+
+	VkDeviceSize aligned = (ringHead + alignment - 1) / alignment * alignment;
+	VkDeviceSize consumed;
+
+	if (ringHead >= ringTail) { // free space is the end of the ring and the start up to the tail
+		if (aligned + size <= ringSize) {
+			offset = aligned;
+			consumed = aligned + size - ringHead;
+		}
+		else if (size <= ringTail) { // wrap around, the rest of the ring is skipped
+			offset = 0;
+			consumed = ringSize - ringHead + size;
+		}
+		else {
+			return false;
+		}
+	}
+	else { // wrapped, free space is between the head and the tail
+		if (aligned + size > ringTail) {
+			return false;
+		}
+		offset = aligned;
+		consumed = aligned + size - ringHead;
+	}
+
+	ringHead = offset + size;
+	ringUsed += consumed;
+	recording.ringBytes += consumed;
+	recording.ringEnd = ringHead;
+	return true;
+}
+
+VkDeviceSize UploadManager::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+	if (size > ringSize) {
+		throw std::runtime_error("upload is larger than the staging ring!");
+	}
+
+	VkDeviceSize offset;
+	while (!tryReserve(size, alignment, offset)) {
+		submit(); // the copies recorded so far hold staging space too, get them going so it comes back
+		ringStalls++;
+		reclaim(true);
+	}
+
+	std::memcpy(static_cast<uint8_t*>(stagingMemory.mapped) + offset, data, static_cast<size_t>(size));
+	gpuAllocator.flush(stagingMemory, offset, size);
+	return offset;
+}
+
+void UploadManager::beginBatch() {
+	if (recording.commandBuffer != VK_NULL_HANDLE) {
+		return;
+	}
+
+	if (!freeBatches.empty()) {
+		recording.commandBuffer = freeBatches.back().commandBuffer;
+		recording.fence = freeBatches.back().fence;
+		freeBatches.pop_back();
+	}
+	else {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &recording.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(logicalDevice, &fenceInfo, nullptr, &recording.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+	}
+
+	if (!freeSemaphores.empty()) {
+		recording.semaphore = freeSemaphores.back();
+		freeSemaphores.pop_back();
+	}
+	else {
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &recording.semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload semaphore!");
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(recording.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording upload command buffer!");
+	}
+}
+
+void UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	bool transferOwnership = transferFamily != graphicsFamily;
+
+	while (size > 0) {
+		VkDeviceSize chunk = std::min(size, ringSize);
+		VkDeviceSize stagingOffset = stage(bytes, chunk, 16);
+		beginBatch(); // after staging, which may have submitted the previous batch to make room
+
+		VkBufferCopy region{};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = offset;
+		region.size = chunk;
+		vkCmdCopyBuffer(recording.commandBuffer, stagingBuffer, buffer, 1, &region);
+
+		// the same barrier is recorded on both queues, once to release the range and once to acquire it
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transferOwnership ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = transferOwnership ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = chunk;
+
+		if (transferOwnership) {
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0; // ignored on the releasing queue
+			vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+
+		barrier.srcAccessMask = 0; // the semaphore already made the transfer writes available
+		barrier.dstAccessMask = dstAccess;
+		recordingHandoff.bufferBarriers.push_back(barrier);
+		recordingHandoff.waitStage |= dstStage;
+
+		bytesUploaded += chunk;
+		bytes += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+}
+
+void UploadManager::uploadImage(VkImage image, VkExtent3D extent, VkImageAspectFlags aspect, const void* data, VkDeviceSize size, VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	bool transferOwnership = transferFamily != graphicsFamily;
+
+	VkDeviceSize stagingOffset = stage(data, size, 16); // a multiple of every texel size up to 16 bytes, and of 4 as copies require
+	beginBatch();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; // the old contents are discarded
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = aspect;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = extent;
+	vkCmdCopyBufferToImage(recording.commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// the layout transition is part of the ownership transfer, both sides have to name the same layouts
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = finalLayout;
+	barrier.srcQueueFamilyIndex = transferOwnership ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = transferOwnership ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+	if (transferOwnership) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	recordingHandoff.imageBarriers.push_back(barrier);
+	recordingHandoff.waitStage |= dstStage;
+
+	bytesUploaded += size;
+}
+
+void UploadManager::submit() {
+	if (recording.commandBuffer == VK_NULL_HANDLE) {
+		return;
+	}
+
+	if (vkEndCommandBuffer(recording.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &recording.commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &recording.semaphore;
+
+	if (vkQueueSubmit(transferQueue, 1, &submitInfo, recording.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+
+	pendingHandoff.semaphores.push_back(recording.semaphore);
+	pendingHandoff.waitStage |= recordingHandoff.waitStage;
+	pendingHandoff.bufferBarriers.insert(pendingHandoff.bufferBarriers.end(), recordingHandoff.bufferBarriers.begin(), recordingHandoff.bufferBarriers.end());
+	pendingHandoff.imageBarriers.insert(pendingHandoff.imageBarriers.end(), recordingHandoff.imageBarriers.begin(), recordingHandoff.imageBarriers.end());
+	recordingHandoff = UploadHandoff{};
+
+	recording.semaphore = VK_NULL_HANDLE; // owned by the handoff now
+	inFlight.push_back(recording);
+	recording = Batch{};
+	batchesSubmitted++;
+}
+
+UploadHandoff UploadManager::takeHandoff(uint64_t frameNumber) {
+	submit();
+
+	UploadHandoff handoff = std::move(pendingHandoff);
+	pendingHandoff = UploadHandoff{};
+
+	for (VkSemaphore semaphore : handoff.semaphores) {
+		retiredSemaphores.push_back({ semaphore, frameNumber });
+	}
+	return handoff;
+}
+
+void UploadManager::recordAcquire(VkCommandBuffer commandBuffer, const UploadHandoff& handoff) {
+	if (handoff.bufferBarriers.empty() && handoff.imageBarriers.empty()) {
+		return;
+	}
+
+	// the source stage matches the semaphore's wait stage, which chains the barrier to the transfer queue's work
+	vkCmdPipelineBarrier(commandBuffer, handoff.waitStage, handoff.waitStage, 0, 0, nullptr,
+		static_cast<uint32_t>(handoff.bufferBarriers.size()), handoff.bufferBarriers.data(), static_cast<uint32_t>(handoff.imageBarriers.size()), handoff.imageBarriers.data());
+}
+
+void UploadManager::reclaim(bool wait) {
+	// batches run on one queue and finish in submission order
+	while (!inFlight.empty()) {
+		Batch& batch = inFlight.front();
+		if (wait) {
+			vkWaitForFences(logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+			wait = false; // only block for the oldest one
+		}
+		else if (vkGetFenceStatus(logicalDevice, batch.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		ringTail = batch.ringEnd;
+		ringUsed -= batch.ringBytes;
+
+		vkResetFences(logicalDevice, 1, &batch.fence);
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		freeBatches.push_back(batch);
+		inFlight.pop_front();
+	}
+}
+
+void UploadManager::collect(uint64_t completedFrames) {
+	reclaim(false);
+
+	// a semaphore can only be signaled again once the wait on it has executed
+	auto retired = std::remove_if(retiredSemaphores.begin(), retiredSemaphores.end(), [&](const RetiredSemaphore& semaphore) {
+		if (semaphore.frame < completedFrames) {
+			freeSemaphores.push_back(semaphore.semaphore);
+			return true;
+		}
+		return false;
+	});
+	retiredSemaphores.erase(retired, retiredSemaphores.end());
+}
+
+uint64_t UploadManager::getBytesUploaded() const {
+	return bytesUploaded;
+}
+
+uint64_t UploadManager::getBatchesSubmitted() const {
+	return batchesSubmitted;
+}
+
+uint64_t UploadManager::getRingStalls() const {
+	return ringStalls;
+}
+
+bool UploadManager::usesDedicatedQueue() const {
+	return transferFamily != graphicsFamily;
+}
+
+void UploadManager::destroy() {
+	vkQueueWaitIdle(transferQueue);
+	reclaim(false);
+
+	for (auto& batch : freeBatches) {
+		vkDestroyFence(logicalDevice, batch.fence, nullptr);
+	}
+	freeBatches.clear();
+
+	if (recording.fence != VK_NULL_HANDLE) { // recorded but never submitted
+		vkDestroyFence(logicalDevice, recording.fence, nullptr);
+		vkDestroySemaphore(logicalDevice, recording.semaphore, nullptr);
+		recording = Batch{};
+	}
+
+	for (VkSemaphore semaphore : freeSemaphores) {
+		vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+	}
+	for (auto& retired : retiredSemaphores) {
+		vkDestroySemaphore(logicalDevice, retired.semaphore, nullptr);
+	}
+	for (VkSemaphore semaphore : pendingHandoff.semaphores) {
+		vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+	}
+	freeSemaphores.clear();
+	retiredSemaphores.clear();
+	pendingHandoff = UploadHandoff{};
+
+	vkDestroyCommandPool(logicalDevice, commandPool, nullptr); // also frees the command buffers
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	gpuAllocator.free(stagingMemory);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "../headers/vertex_format.h"
+#include <stdexcept>
+
+static uint32_t formatSize(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_R8G8_SNORM: return 2;
+	case VK_FORMAT_R8G8B8A8_SNORM: case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R16G16_SNORM: case VK_FORMAT_R16G16_UNORM: case VK_FORMAT_R16G16_SFLOAT: return 4;
+	case VK_FORMAT_R16G16B16A16_SNORM: case VK_FORMAT_R16G16B16A16_SFLOAT: case VK_FORMAT_R32G32_SFLOAT: return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT: return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+	default: throw std::runtime_error("unsupported vertex format!");
+	}
+}
+
+static VkFormat positionFormat(PositionEncoding encoding) {
+	switch (encoding) {
+	case PositionEncoding::Half: return VK_FORMAT_R16G16B16A16_SFLOAT; // 3 component 16-bit formats are rarely supported for vertex buffers, w is padding
+	case PositionEncoding::Snorm16: return VK_FORMAT_R16G16B16A16_SNORM;
+	default: return VK_FORMAT_R32G32B32_SFLOAT;
+	}
+}
+
+static VkFormat normalFormat(DirectionEncoding encoding) {
+	switch (encoding) {
+	case DirectionEncoding::Octahedral16: return VK_FORMAT_R16G16_SNORM;
+	case DirectionEncoding::Octahedral8: return VK_FORMAT_R8G8_SNORM;
+	default: return VK_FORMAT_R32G32B32_SFLOAT;
+	}
+}
+
+// tangents carry the bitangent sign next to the direction, which takes the octahedral encodings to four components
+static VkFormat tangentFormat(DirectionEncoding encoding) {
+	switch (encoding) {
+	case DirectionEncoding::Octahedral16: return VK_FORMAT_R16G16B16A16_SNORM;
+	case DirectionEncoding::Octahedral8: return VK_FORMAT_R8G8B8A8_SNORM;
+	default: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	}
+}
+
+static VkFormat texCoordFormat(TexCoordEncoding encoding) {
+	switch (encoding) {
+	case TexCoordEncoding::Half: return VK_FORMAT_R16G16_SFLOAT;
+	case TexCoordEncoding::Unorm16: return VK_FORMAT_R16G16_UNORM;
+	default: return VK_FORMAT_R32G32_SFLOAT;
+	}
+}
+
+
+VertexFormat VertexFormat::fullPrecision() const {
+	VertexFormat format = *this;
+	format.position = PositionEncoding::Float32;
+	format.direction = DirectionEncoding::Float32;
+	format.texCoord = TexCoordEncoding::Float32;
+	if (format.color != ColorEncoding::None) {
+		format.color = ColorEncoding::Float32;
+	}
+	format.index = IndexEncoding::Uint32;
+	return format;
+}
+
+std::vector<VertexFormat::Attribute> VertexFormat::attributes() const {
+	std::vector<VkFormat> formats = { positionFormat(position), normalFormat(direction), tangents ? tangentFormat(direction) : VK_FORMAT_UNDEFINED, texCoordFormat(texCoord),
+		color == ColorEncoding::Unorm8 ? VK_FORMAT_R8G8B8A8_UNORM : color == ColorEncoding::Float32 ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_UNDEFINED };
+
+	std::vector<Attribute> result;
+	uint32_t offset = 0;
+	for (uint32_t location = 0; location < formats.size(); location++) {
+		if (formats[location] == VK_FORMAT_UNDEFINED) {
+			continue;
+		}
+		offset = (offset + 3) / 4 * 4;
+		result.push_back({ static_cast<VertexAttribute>(location), formats[location], offset });
+		offset += formatSize(formats[location]);
+	}
+	return result;
+}
+
+uint32_t VertexFormat::stride() const {
+	std::vector<Attribute> layout = attributes();
+	const Attribute& last = layout.back();
+	return (last.offset + formatSize(last.format) + 3) / 4 * 4; // keeps every vertex 4-byte aligned
+}
+
+VkIndexType VertexFormat::indexType(uint32_t vertexCount) const {
+	bool fits16 = vertexCount <= 0xFFFF; // 0xFFFF is left out, it is the primitive restart index
+	if (index == IndexEncoding::Uint16 && !fits16) {
+		throw std::runtime_error("mesh has too many vertices for 16-bit indices!");
+	}
+	return index == IndexEncoding::Uint32 || !fits16 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+}
+
+bool VertexFormat::octahedralDirections() const {
+	return direction != DirectionEncoding::Float32;
+}
+
+void VertexFormat::describe(const ShaderReflection& vertexStage, std::vector<VkVertexInputBindingDescription>& bindings, std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const {
+	bindings.clear();
+	attributeDescriptions.clear();
+
+	std::vector<Attribute> layout = attributes();
+	for (const auto& input : vertexStage.vertexInputs) {
+		auto attribute = layout.begin();
+		while (attribute != layout.end() && static_cast<uint32_t>(attribute->attribute) != input.location) {
+			++attribute;
+		}
+		if (attribute == layout.end()) {
+			throw std::runtime_error("vertex shader reads an attribute the vertex format doesn't store!");
+		}
+
+		VkVertexInputAttributeDescription description{};
+		description.location = input.location;
+		description.binding = 0;
+		description.format = attribute->format;
+		description.offset = attribute->offset;
+		attributeDescriptions.push_back(description);
+	}
+
+	if (!attributeDescriptions.empty()) {
+		VkVertexInputBindingDescription binding{};
+		binding.binding = 0;
+		binding.stride = stride();
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindings.push_back(binding);
+	}
+}
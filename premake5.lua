@@ -25,7 +25,15 @@ project "Engine"
       architecture "x64"
       systemversion "latest"
       defines { "PLATFORM_WINDOWS" }
-      links { "vulkan-1", "glfw3" }
+      links { "vulkan-1", "glfw3", "shaderc_shared", "spirv-cross-core" }
+      -- Release builds load the SPIR-V, so it is regenerated from the GLSL sources on every build
+      prebuildmessage "Compiling shaders"
+      prebuildcommands { "call %{prj.name}\\shaders\\compile_shaders.bat nopause" }
+      -- spirv-tools' optimizer only comes as static libraries, which not every SDK install has. Without them shaderc optimizes while it compiles
+      if os.isfile(IncludeDir["Vulkan"] .. "/Lib/SPIRV-Tools-opt.lib") and os.isfile(IncludeDir["Vulkan"] .. "/Lib/SPIRV-Tools.lib") then
+         defines { "SPIRV_TOOLS_OPTIMIZER" }
+         links { "SPIRV-Tools-opt", "SPIRV-Tools" }
+      end
 
       
    -- TODO MacOS specific settings
@@ -37,7 +45,18 @@ project "Engine"
    --    systemversion "latest"
    --    defines { "PLATFORM_MACOS" }
 
-   -- TODO Linux specific settings
+   -- Linux settings -- uses the system Vulkan loader and GLFW, the GLFW headers are platform independent
+   filter "system:linux"
+      includedirs { IncludeDir["Vulkan"] .. "/Include", IncludeDir["GLFW"] .. "/Windows/include", IncludeDir["glm"] }
+      architecture "x64"
+      defines { "PLATFORM_LINUX" }
+      links { "vulkan", "glfw", "shaderc_shared", "spirv-cross-core", "pthread" }
+      prebuildmessage "Compiling shaders"
+      prebuildcommands { "sh %{prj.name}/shaders/compile_shaders.sh" }
+      if os.findlib("SPIRV-Tools-opt") and os.findlib("SPIRV-Tools") then
+         defines { "SPIRV_TOOLS_OPTIMIZER" }
+         links { "SPIRV-Tools-opt", "SPIRV-Tools" }
+      end
 
       -- General settings for Debug and Release configurations
    filter "configurations:Debug"